@@ -0,0 +1,55 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+//small helpers shared by the benchmarks, nothing here is part of avenir
+namespace bench
+{
+
+//wall time of one call to f in seconds
+template <typename Func>
+double timeIt(Func&& f)
+{
+	auto start = std::chrono::steady_clock::now();
+	f();
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	return elapsed.count();
+}
+
+//runs f(threadIndex) on numThreads threads that are all released together,
+//returns the wall time from the release until the last one finishes
+template <typename Func>
+double timeThreads(uint32_t numThreads, Func&& f)
+{
+	std::atomic<bool> go = false;
+	std::vector<std::thread> threads;
+	for(uint32_t i = 0; i < numThreads; i++)
+	{
+		threads.emplace_back([&go, &f, i]{
+			while(!go.load(std::memory_order_acquire)) { std::this_thread::yield(); }
+			f(i);
+		});
+	}
+	return timeIt([&]{
+		go.store(true, std::memory_order_release);
+		for(auto& thread : threads) { thread.join(); }
+	});
+}
+
+inline uint32_t defaultThreads()
+{
+	uint32_t n = std::thread::hardware_concurrency();
+	return n != 0 ? n : 4;
+}
+
+inline void report(const char* name, uint64_t ops, double seconds)
+{
+	std::printf("%-48s %10.2f Mops/s %10.1f ns/op\n", name,
+		ops / seconds / 1e6, seconds * 1e9 / ops);
+}
+
+}
@@ -0,0 +1,82 @@
+//wake up latency of a thread blocked on a future, from the moment another
+//thread sets the value until the waiter runs again. avenir's futex based
+//wait and waitFor against std::future's mutex and condition variable
+//usage: FutureWaitBench [rounds]
+#include <chrono>
+#include <cstdlib>
+#include <future>
+#include <thread>
+
+#include "Bench.h"
+#include "Future.h"
+
+using namespace avenir;
+
+typedef std::chrono::steady_clock Clock;
+
+//runs rounds times: wait(future) on this thread while another thread sets
+//the value a little later, returns the average latency in seconds
+template <typename Make, typename Wait>
+static double measure(uint64_t rounds, Make&& make, Wait&& wait)
+{
+	double total = 0;
+	for(uint64_t r = 0; r < rounds; r++)
+	{
+		auto [promise, future] = make();
+		Clock::time_point setAt;
+		std::thread setter([&]{
+			//give the waiter time to park
+			std::this_thread::sleep_for(std::chrono::microseconds(50));
+			setAt = Clock::now();
+			promise.set();
+		});
+		wait(future);
+		Clock::time_point wokeAt = Clock::now();
+		setter.join();
+		std::chrono::duration<double> latency = wokeAt - setAt;
+		total += latency.count();
+	}
+	return total / rounds;
+}
+
+struct AvenirPromise
+{
+	Promise<int> promise;
+	void set() { promise.setValue(1); }
+};
+
+struct StdPromise
+{
+	std::promise<int> promise;
+	void set() { promise.set_value(1); }
+};
+
+static std::pair<AvenirPromise, Future<int>> makeAvenir()
+{
+	AvenirPromise p;
+	Future<int> f = p.promise.getFuture();
+	return {std::move(p), std::move(f)};
+}
+
+static std::pair<StdPromise, std::future<int>> makeStd()
+{
+	StdPromise p;
+	std::future<int> f = p.promise.get_future();
+	return {std::move(p), std::move(f)};
+}
+
+static void reportLatency(const char* name, double seconds)
+{
+	std::printf("%-48s %10.1f ns avg wake latency\n", name, seconds * 1e9);
+}
+
+int main(int argc, char** argv)
+{
+	uint64_t rounds = argc > 1 ? std::atoll(argv[1]) : 2000;
+	const auto timeout = std::chrono::seconds(10);
+
+	reportLatency("avenir::Future::wait", measure(rounds, makeAvenir, [](Future<int>& f){ f.wait(); }));
+	reportLatency("avenir::Future::waitFor", measure(rounds, makeAvenir, [&](Future<int>& f){ f.waitFor(timeout); }));
+	reportLatency("std::future::wait", measure(rounds, makeStd, [](std::future<int>& f){ f.wait(); }));
+	reportLatency("std::future::wait_for", measure(rounds, makeStd, [&](std::future<int>& f){ f.wait_for(timeout); }));
+}
@@ -0,0 +1,54 @@
+//memory bandwidth of jobs that stream over a per thread buffer, with the
+//pool's threads left to the scheduler and pinned per core or per node. the
+//buffer is first touched by the thread that owns it, so a thread that
+//migrates to another socket afterwards reads remote memory
+//usage: NumaBench [threads] [MB per thread] [rounds]
+#include <cstdlib>
+#include <numeric>
+#include <vector>
+
+#include "Bench.h"
+#include "ThreadPool.h"
+
+using namespace avenir;
+
+static size_t s_words = 0;
+
+static uint64_t streamOwnBuffer()
+{
+	thread_local std::vector<uint64_t> buffer;
+	if(buffer.size() != s_words)
+	{
+		buffer.assign(s_words, 0);
+		std::iota(buffer.begin(), buffer.end(), 0);
+	}
+	return std::accumulate(buffer.begin(), buffer.end(), uint64_t(0));
+}
+
+static void measure(const char* name, uint32_t threads, uint32_t rounds, Placement placement)
+{
+	ThreadPool pool(threads, std::move(placement));
+	uint64_t checksum = 0;
+
+	//warm up: every thread gets a chance to allocate and touch its buffer
+	for(auto& f : pool.pushJobs(threads * 4, [](size_t){ return streamOwnBuffer; })) { checksum += f.get(); }
+
+	double seconds = bench::timeIt([&]{
+		for(auto& f : pool.pushJobs(threads * rounds, [](size_t){ return streamOwnBuffer; })) { checksum += f.get(); }
+	});
+	double bytes = double(threads) * rounds * s_words * sizeof(uint64_t);
+	std::printf("%-40s %10.2f GB/s (%llu)\n", name, bytes / seconds / 1e9,
+		static_cast<unsigned long long>(checksum & 0xff));
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t threads = argc > 1 ? std::atoi(argv[1]) : bench::defaultThreads();
+	s_words = (argc > 2 ? std::atoll(argv[2]) : 64) * 1024 * 1024 / sizeof(uint64_t);
+	uint32_t rounds = argc > 3 ? std::atoi(argv[3]) : 20;
+
+	std::printf("%zu NUMA node(s)\n", Topology::get().nodes.size());
+	measure("unpinned", threads, rounds, Placement());
+	measure("pinned per core", threads, rounds, Placement::perCore());
+	measure("pinned per node", threads, rounds, Placement::perNode());
+}
@@ -0,0 +1,62 @@
+//parallelFor with each schedule against a serial loop and against the old
+//pattern of one pushJob per chunk followed by waiting on every future
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#include "Bench.h"
+#include "Parallel.h"
+
+using namespace avenir;
+
+//uniform: every iteration costs the same, skewed: cost grows with the index
+static double work(uint64_t i, bool skewed)
+{
+	uint64_t rounds = skewed ? 1 + i % 64 : 32;
+	double x = static_cast<double>(i);
+	for(uint64_t r = 0; r < rounds; r++) { x = std::sqrt(x + r); }
+	return x;
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t threads = argc > 1 ? std::atoi(argv[1]) : bench::defaultThreads();
+	const uint64_t count = 4000000;
+	ThreadPool pool(threads - 1); //the calling thread makes up the last one
+	std::vector<double> out(count);
+
+	for(bool skewed : {false, true})
+	{
+		std::printf("%s iterations\n", skewed ? "skewed" : "uniform");
+
+		bench::report("  serial loop", count, bench::timeIt([&]{
+			for(uint64_t i = 0; i < count; i++) { out[i] = work(i, skewed); }
+		}));
+
+		bench::report("  pushJob per chunk", count, bench::timeIt([&]{
+			const uint64_t chunk = count / (threads * 8);
+			std::vector<Future<void>> futures;
+			for(uint64_t lo = 0; lo < count; lo += chunk)
+			{
+				futures.push_back(pool.pushJob([&, lo]{
+					uint64_t hi = std::min(lo + chunk, count);
+					for(uint64_t i = lo; i < hi; i++) { out[i] = work(i, skewed); }
+				}));
+			}
+			for(auto& future : futures) { future.get(); }
+		}));
+
+		const std::pair<Schedule, const char*> schedules[] = {
+			{Schedule::Static, "  parallelFor static"},
+			{Schedule::Dynamic, "  parallelFor dynamic"},
+			{Schedule::Guided, "  parallelFor guided"},
+			{Schedule::Adaptive, "  parallelFor adaptive"}
+		};
+		for(auto& [schedule, name] : schedules)
+		{
+			bench::report(name, count, bench::timeIt([&]{
+				parallelFor(pool, uint64_t(0), count, [&](uint64_t i){ out[i] = work(i, skewed); }, schedule);
+			}));
+		}
+	}
+}
@@ -0,0 +1,63 @@
+//round trip latency between two threads handing a value back and forth, with
+//and without the spin phase before parking. once through a pair of futures
+//per round, once from the calling thread to an idle ThreadPool worker and back
+//usage: PingPongBench [rounds]
+#include <algorithm>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "Bench.h"
+#include "ThreadPool.h"
+
+using namespace avenir;
+
+static double futurePingPong(uint64_t rounds)
+{
+	std::vector<Promise<uint64_t>> pings(rounds), pongs(rounds);
+	std::vector<Future<uint64_t>> pingFutures, pongFutures;
+	for(uint64_t r = 0; r < rounds; r++)
+	{
+		pingFutures.push_back(pings[r].getFuture());
+		pongFutures.push_back(pongs[r].getFuture());
+	}
+
+	std::thread other([&]{
+		for(uint64_t r = 0; r < rounds; r++) { pongs[r].setValue(pingFutures[r].get() + 1); }
+	});
+	double seconds = bench::timeIt([&]{
+		for(uint64_t r = 0; r < rounds; r++)
+		{
+			pings[r].setValue(r);
+			pongFutures[r].wait();
+		}
+	});
+	other.join();
+	return seconds;
+}
+
+static double poolPingPong(uint64_t rounds)
+{
+	ThreadPool pool(1);
+	return bench::timeIt([&]{
+		for(uint64_t r = 0; r < rounds; r++)
+		{
+			pool.pushJob([r]{ return r + 1; }).wait();
+		}
+	});
+}
+
+int main(int argc, char** argv)
+{
+	uint64_t rounds = argc > 1 ? std::atoll(argv[1]) : 100000;
+	//the default is 0 on a single core, force it on to compare
+	uint32_t spinRounds = std::max(AdaptiveSpinner::getMaxRounds(), AdaptiveSpinner::PauseRounds + 54);
+
+	AdaptiveSpinner::setMaxRounds(0);
+	bench::report("futures, park right away", rounds, futurePingPong(rounds));
+	bench::report("pool worker, park right away", rounds, poolPingPong(rounds));
+
+	AdaptiveSpinner::setMaxRounds(spinRounds);
+	bench::report("futures, adaptive spin then park", rounds, futurePingPong(rounds));
+	bench::report("pool worker, adaptive spin then park", rounds, poolPingPong(rounds));
+}
@@ -0,0 +1,47 @@
+//per task overhead of ThreadPool::post against ThreadPool::pushJob for
+//empty jobs, submitted both from outside the pool and from inside a job
+#include <cstdlib>
+
+#include "Bench.h"
+#include "ThreadPool.h"
+
+using namespace avenir;
+
+static void waitFor(std::atomic<uint64_t>& done, uint64_t count)
+{
+	while(done.load(std::memory_order_acquire) != count) { std::this_thread::yield(); }
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t threads = argc > 1 ? std::atoi(argv[1]) : bench::defaultThreads();
+	const uint64_t count = 1000000;
+	ThreadPool pool(threads);
+	std::atomic<uint64_t> done = 0;
+	auto job = [&done]{ done.fetch_add(1, std::memory_order_release); };
+
+	done = 0;
+	bench::report("post, external thread", count, bench::timeIt([&]{
+		for(uint64_t i = 0; i < count; i++) { pool.post(job); }
+		waitFor(done, count);
+	}));
+
+	done = 0;
+	bench::report("pushJob, external thread", count, bench::timeIt([&]{
+		for(uint64_t i = 0; i < count; i++) { pool.pushJob(job); }
+		waitFor(done, count);
+	}));
+
+	//from inside the pool the jobs land on the worker's own deque
+	done = 0;
+	bench::report("post, from a worker", count, bench::timeIt([&]{
+		pool.post([&]{ for(uint64_t i = 0; i < count; i++) { pool.post(job); } });
+		waitFor(done, count);
+	}));
+
+	done = 0;
+	bench::report("pushJob, from a worker", count, bench::timeIt([&]{
+		pool.post([&]{ for(uint64_t i = 0; i < count; i++) { pool.pushJob(job); } });
+		waitFor(done, count);
+	}));
+}
@@ -0,0 +1,73 @@
+//queueing latency of short probe jobs while the pool is buried under a
+//backlog of background work, from pushJob until the probe starts running.
+//probes and background at the same priority queue behind each other, a High
+//probe over Low background only waits for a thread to finish its current job
+//usage: PriorityBench [threads] [background jobs per thread] [probes]
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "Bench.h"
+#include "ThreadPool.h"
+
+using namespace avenir;
+
+typedef std::chrono::steady_clock Clock;
+
+//about 20us of work that the compiler can't throw away
+static uint64_t busyWork(uint64_t seed)
+{
+	Clock::time_point end = Clock::now() + std::chrono::microseconds(20);
+	uint64_t x = seed;
+	while(Clock::now() < end)
+	{
+		for(int i = 0; i < 64; i++) { x = x * 6364136223846793005ull + 1442695040888963407ull; }
+	}
+	return x;
+}
+
+static void measure(const char* name, uint32_t threads, uint64_t background, uint32_t probes,
+	Priority backgroundPriority, Priority probePriority)
+{
+	ThreadPool pool(threads);
+	std::vector<Future<uint64_t>> work;
+	work.reserve(background);
+	for(uint64_t i = 0; i < background; i++)
+	{
+		work.push_back(pool.pushJob(backgroundPriority, [i]{ return busyWork(i); }));
+	}
+
+	//probes are spread out so they sample the backlog while it drains
+	std::vector<double> latencies(probes);
+	std::vector<Future<void>> done;
+	for(uint32_t p = 0; p < probes; p++)
+	{
+		Clock::time_point pushedAt = Clock::now();
+		done.push_back(pool.pushJob(probePriority, [&latencies, p, pushedAt]{
+			std::chrono::duration<double> waited = Clock::now() - pushedAt;
+			latencies[p] = waited.count();
+		}));
+		std::this_thread::sleep_for(std::chrono::microseconds(200));
+	}
+	for(auto& f : done) { f.wait(); }
+	uint64_t checksum = 0;
+	for(auto& f : work) { checksum += f.get(); }
+
+	std::sort(latencies.begin(), latencies.end());
+	auto at = [&](double q){ return latencies[std::min<size_t>(probes - 1, q * probes)] * 1e6; };
+	std::printf("%-40s p50 %9.1f us  p99 %9.1f us  max %9.1f us  (%llu)\n", name,
+		at(0.5), at(0.99), latencies.back() * 1e6, static_cast<unsigned long long>(checksum & 0xff));
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t threads = argc > 1 ? std::atoi(argv[1]) : bench::defaultThreads();
+	uint64_t background = (argc > 2 ? std::atoll(argv[2]) : 2000) * threads;
+	uint32_t probes = argc > 3 ? std::atoi(argv[3]) : 100;
+
+	measure("Normal probes, Normal background", threads, background, probes, Priority::Normal, Priority::Normal);
+	measure("High probes, Normal background", threads, background, probes, Priority::Normal, Priority::High);
+	measure("High probes, Low background", threads, background, probes, Priority::Low, Priority::High);
+}
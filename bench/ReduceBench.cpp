@@ -0,0 +1,53 @@
+//parallelReduce and parallelTransformReduce against std::reduce and
+//std::transform_reduce with std::execution::par. libstdc++ runs those on TBB
+#include <cstdlib>
+#include <execution>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "Bench.h"
+#include "Parallel.h"
+
+using namespace avenir;
+
+int main(int argc, char** argv)
+{
+	uint32_t threads = argc > 1 ? std::atoi(argv[1]) : bench::defaultThreads();
+	const size_t count = 50000000;
+	ThreadPool pool(threads - 1);
+
+	std::vector<double> data(count);
+	std::mt19937_64 rng(42);
+	std::uniform_real_distribution<double> dist(-1.0, 1.0);
+	for(double& x : data) { x = dist(rng); }
+
+	double result = 0;
+	auto square = [](double x) { return x * x; };
+
+	bench::report("std::reduce seq", count, bench::timeIt([&]{
+		result += std::reduce(std::execution::seq, data.begin(), data.end(), 0.0);
+	}));
+	bench::report("std::reduce par", count, bench::timeIt([&]{
+		result += std::reduce(std::execution::par, data.begin(), data.end(), 0.0);
+	}));
+	bench::report("parallelReduce fast", count, bench::timeIt([&]{
+		result += parallelReduce(pool, data.begin(), data.end(), 0.0);
+	}));
+	bench::report("parallelReduce deterministic", count, bench::timeIt([&]{
+		result += parallelReduce(pool, data.begin(), data.end(), 0.0, std::plus<>(), Reduction::Deterministic);
+	}));
+
+	bench::report("std::transform_reduce par", count, bench::timeIt([&]{
+		result += std::transform_reduce(std::execution::par, data.begin(), data.end(), 0.0, std::plus<>(), square);
+	}));
+	bench::report("parallelTransformReduce fast", count, bench::timeIt([&]{
+		result += parallelTransformReduce(pool, data.begin(), data.end(), 0.0, std::plus<>(), square);
+	}));
+	bench::report("parallelTransformReduce deterministic", count, bench::timeIt([&]{
+		result += parallelTransformReduce(pool, data.begin(), data.end(), 0.0, std::plus<>(), square,
+			Reduction::Deterministic);
+	}));
+
+	std::printf("(sum of results %f)\n", result);
+}
@@ -0,0 +1,51 @@
+//parallelInclusiveScan and parallelExclusiveScan against std::inclusive_scan,
+//serial and with std::execution::par, for the common element types
+//usage: ScanBench [threads] [elements]
+#include <cstdlib>
+#include <execution>
+#include <numeric>
+#include <vector>
+
+#include "Bench.h"
+#include "Parallel.h"
+
+using namespace avenir;
+
+template <typename T>
+void run(ThreadPool& pool, const char* type, size_t count)
+{
+	std::vector<T> in(count);
+	std::vector<T> out(count);
+	for(size_t i = 0; i < count; i++) { in[i] = static_cast<T>(i % 7); }
+
+	char name[64];
+	std::snprintf(name, sizeof(name), "%-8s std::inclusive_scan seq", type);
+	bench::report(name, count, bench::timeIt([&]{
+		std::inclusive_scan(in.begin(), in.end(), out.begin());
+	}));
+	std::snprintf(name, sizeof(name), "%-8s std::inclusive_scan par", type);
+	bench::report(name, count, bench::timeIt([&]{
+		std::inclusive_scan(std::execution::par, in.begin(), in.end(), out.begin());
+	}));
+	std::snprintf(name, sizeof(name), "%-8s parallelInclusiveScan", type);
+	bench::report(name, count, bench::timeIt([&]{
+		parallelInclusiveScan(pool, in.begin(), in.end(), out.begin());
+	}));
+	std::snprintf(name, sizeof(name), "%-8s parallelExclusiveScan", type);
+	bench::report(name, count, bench::timeIt([&]{
+		parallelExclusiveScan(pool, in.begin(), in.end(), out.begin(), T(0));
+	}));
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t threads = argc > 1 ? std::atoi(argv[1]) : bench::defaultThreads();
+	size_t count = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 100000000;
+	ThreadPool pool(threads - 1);
+
+	std::printf("%zu elements, %zu byte L2\n", count, detail::l2CacheSize());
+	run<int32_t>(pool, "int32", count);
+	run<int64_t>(pool, "int64", count);
+	run<float>(pool, "float", count);
+	run<double>(pool, "double", count);
+}
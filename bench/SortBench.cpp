@@ -0,0 +1,53 @@
+//parallelSort against std::sort, serial and with std::execution::par, on
+//random, sorted and reverse sorted keys of a few sizes
+//usage: SortBench [threads] [largest size]
+#include <algorithm>
+#include <cstdlib>
+#include <execution>
+#include <random>
+#include <vector>
+
+#include "Bench.h"
+#include "Parallel.h"
+
+using namespace avenir;
+
+int main(int argc, char** argv)
+{
+	uint32_t threads = argc > 1 ? std::atoi(argv[1]) : bench::defaultThreads();
+	size_t largest = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 10000000;
+	ThreadPool pool(threads - 1);
+	std::mt19937_64 rng(7);
+
+	for(size_t count = 100000; count <= largest; count *= 10)
+	{
+		std::vector<uint64_t> random(count);
+		for(uint64_t& key : random) { key = rng(); }
+		std::vector<uint64_t> sorted = random;
+		std::sort(sorted.begin(), sorted.end());
+		std::vector<uint64_t> reversed(sorted.rbegin(), sorted.rend());
+
+		const std::pair<const char*, const std::vector<uint64_t>*> inputs[] = {
+			{"random", &random}, {"sorted", &sorted}, {"reverse", &reversed}
+		};
+		for(auto& [kind, input] : inputs)
+		{
+			std::vector<uint64_t> keys;
+			char name[64];
+
+			keys = *input;
+			std::snprintf(name, sizeof(name), "%10zu %-8s std::sort", count, kind);
+			bench::report(name, count, bench::timeIt([&]{ std::sort(keys.begin(), keys.end()); }));
+
+			keys = *input;
+			std::snprintf(name, sizeof(name), "%10zu %-8s std::sort par", count, kind);
+			bench::report(name, count, bench::timeIt([&]{
+				std::sort(std::execution::par, keys.begin(), keys.end());
+			}));
+
+			keys = *input;
+			std::snprintf(name, sizeof(name), "%10zu %-8s parallelSort", count, kind);
+			bench::report(name, count, bench::timeIt([&]{ parallelSort(pool, keys.begin(), keys.end()); }));
+		}
+	}
+}
@@ -0,0 +1,101 @@
+//submit throughput of the lock free injection queue against the std::list +
+//std::mutex queue ThreadPool used to have, first on the bare queues and then
+//through ThreadPool::pushJob
+#include <cstdlib>
+#include <future>
+#include <list>
+#include <mutex>
+
+#include "Bench.h"
+#include "MPMCQueue.h"
+#include "ThreadPool.h"
+
+using namespace avenir;
+
+typedef std::packaged_task<void()> Job;
+
+//the old ThreadPool queue, kept here as the baseline
+struct ListQueue
+{
+	std::list<Job> jobs;
+	std::mutex mutex;
+
+	bool tryPush(Job&& job)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.emplace_back(std::move(job));
+		return true;
+	}
+
+	std::optional<Job> tryPop()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if(jobs.empty()) { return std::nullopt; }
+		std::optional<Job> job(std::move(jobs.front()));
+		jobs.pop_front();
+		return job;
+	}
+};
+
+//producers push perProducer empty jobs each while consumers drain
+template <typename Queue>
+double runQueue(Queue& queue, uint32_t producers, uint32_t consumers, uint64_t perProducer)
+{
+	std::atomic<uint64_t> remaining = producers * perProducer;
+	return bench::timeThreads(producers + consumers, [&](uint32_t index){
+		if(index < producers)
+		{
+			for(uint64_t i = 0; i < perProducer; i++)
+			{
+				while(!queue.tryPush(Job())) { std::this_thread::yield(); }
+			}
+			return;
+		}
+		while(remaining.load(std::memory_order_relaxed) != 0)
+		{
+			if(queue.tryPop()) { remaining.fetch_sub(1, std::memory_order_relaxed); }
+			else { std::this_thread::yield(); }
+		}
+	});
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t threads = argc > 1 ? std::atoi(argv[1]) : bench::defaultThreads();
+	const uint64_t perProducer = 200000;
+
+	for(uint32_t producers : {1u, threads / 2 + 1, threads * 2})
+	{
+		uint32_t consumers = threads / 2 + 1;
+		uint64_t ops = producers * perProducer;
+		char name[64];
+
+		ListQueue listQueue;
+		std::snprintf(name, sizeof(name), "list+mutex   %2u producers %2u consumers", producers, consumers);
+		bench::report(name, ops, runQueue(listQueue, producers, consumers, perProducer));
+
+		MPMCQueue<Job> mpmcQueue;
+		std::snprintf(name, sizeof(name), "MPMCQueue    %2u producers %2u consumers", producers, consumers);
+		bench::report(name, ops, runQueue(mpmcQueue, producers, consumers, perProducer));
+	}
+
+	for(uint32_t producers : {1u, threads * 2})
+	{
+		ThreadPool pool(threads);
+		const uint64_t perThread = 50000;
+		std::vector<std::vector<Future<void>>> futures(producers);
+		double seconds = bench::timeThreads(producers, [&](uint32_t index){
+			futures[index].reserve(perThread);
+			for(uint64_t i = 0; i < perThread; i++)
+			{
+				futures[index].push_back(pool.pushJob([]{}));
+			}
+		});
+
+		char name[64];
+		std::snprintf(name, sizeof(name), "pushJob      %2u producers", producers);
+		bench::report(name, producers * perThread, seconds);
+
+		for(auto& list : futures) { for(auto& future : list) { future.get(); } }
+	}
+}
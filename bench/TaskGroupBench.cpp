@@ -0,0 +1,84 @@
+//recursive fib and quicksort on TaskGroup with a growing number of threads.
+//every level waits on its children, which only scales (or even finishes on
+//a small pool) because waiting threads run queued jobs instead of sleeping
+//usage: TaskGroupBench [max threads]
+#include <algorithm>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "Bench.h"
+#include "TaskGroup.h"
+
+using namespace avenir;
+
+static uint64_t serialFib(uint32_t n)
+{
+	return n < 2 ? n : serialFib(n - 1) + serialFib(n - 2);
+}
+
+static uint64_t fib(ThreadPool& pool, uint32_t n)
+{
+	if(n < 20) { return serialFib(n); }
+
+	uint64_t a, b;
+	TaskGroup group(pool);
+	group.spawn([&]{ a = fib(pool, n - 1); });
+	b = fib(pool, n - 2);
+	group.wait();
+	return a + b;
+}
+
+static void quicksort(ThreadPool& pool, uint32_t* first, uint32_t* last)
+{
+	if(last - first < 4096)
+	{
+		std::sort(first, last);
+		return;
+	}
+
+	uint32_t pivot = first[(last - first) / 2];
+	uint32_t* mid1 = std::partition(first, last, [pivot](uint32_t x){ return x < pivot; });
+	uint32_t* mid2 = std::partition(mid1, last, [pivot](uint32_t x){ return x == pivot; });
+
+	TaskGroup group(pool);
+	group.spawn([&pool, first, mid1]{ quicksort(pool, first, mid1); });
+	quicksort(pool, mid2, last);
+	group.wait();
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t maxThreads = argc > 1 ? std::atoi(argv[1]) : bench::defaultThreads();
+	const uint32_t fibN = 40;
+	const size_t sortCount = 20000000;
+
+	std::vector<uint32_t> input(sortCount);
+	std::mt19937 rng(11);
+	for(uint32_t& x : input) { x = rng(); }
+
+	uint64_t result = 0;
+	std::printf("fib(%u) serial %.3f s\n", fibN, bench::timeIt([&]{ result += serialFib(fibN); }));
+	for(uint32_t threads = 1; threads <= maxThreads; threads *= 2)
+	{
+		ThreadPool pool(threads - 1); //the calling thread helps while it waits
+		std::printf("fib(%u) %2u threads %.3f s\n", fibN, threads, bench::timeIt([&]{
+			result += fib(pool, fibN);
+		}));
+	}
+
+	std::vector<uint32_t> keys = input;
+	std::printf("quicksort %zu serial %.3f s\n", sortCount, bench::timeIt([&]{
+		std::sort(keys.begin(), keys.end());
+	}));
+	for(uint32_t threads = 1; threads <= maxThreads; threads *= 2)
+	{
+		ThreadPool pool(threads - 1);
+		keys = input;
+		std::printf("quicksort %zu %2u threads %.3f s\n", sortCount, threads, bench::timeIt([&]{
+			quicksort(pool, keys.data(), keys.data() + keys.size());
+		}));
+	}
+
+	std::printf("(checksum %llu)\n", static_cast<unsigned long long>(result));
+}
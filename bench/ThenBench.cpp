@@ -0,0 +1,68 @@
+//10 stage pipelines: waiting on every stage with get() before submitting the
+//next one, against chaining the stages with Future::then so nothing blocks
+//until the very end
+//usage: ThenBench [threads] [chains]
+#include <cstdlib>
+#include <vector>
+
+#include "Bench.h"
+#include "ThreadPool.h"
+
+using namespace avenir;
+
+static uint64_t stage(uint64_t x)
+{
+	return x * 6364136223846793005ull + 1442695040888963407ull;
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t threads = argc > 1 ? std::atoi(argv[1]) : bench::defaultThreads();
+	uint64_t chains = argc > 2 ? std::atoll(argv[2]) : 100000;
+	const uint32_t stages = 10;
+	ThreadPool pool(threads);
+	uint64_t result = 0;
+
+	bench::report("get() after every stage", chains * stages, bench::timeIt([&]{
+		for(uint64_t c = 0; c < chains; c++)
+		{
+			uint64_t x = c;
+			for(uint32_t s = 0; s < stages; s++)
+			{
+				x = pool.pushJob([x]{ return stage(x); }).get();
+			}
+			result += x;
+		}
+	}));
+
+	//every chain is in flight at once, each stage is posted when the last one ends
+	std::vector<Future<uint64_t>> ends(chains);
+	bench::report("then(pool, f), one get() per chain", chains * stages, bench::timeIt([&]{
+		for(uint64_t c = 0; c < chains; c++)
+		{
+			Future<uint64_t> f = pool.pushJob([c]{ return stage(c); });
+			for(uint32_t s = 1; s < stages; s++)
+			{
+				f = f.then(pool, [](uint64_t x){ return stage(x); });
+			}
+			ends[c] = std::move(f);
+		}
+		for(auto& f : ends) { result += f.get(); }
+	}));
+
+	//the later stages run on whichever thread finished the one before
+	bench::report("then(f) inline, one get() per chain", chains * stages, bench::timeIt([&]{
+		for(uint64_t c = 0; c < chains; c++)
+		{
+			Future<uint64_t> f = pool.pushJob([c]{ return stage(c); });
+			for(uint32_t s = 1; s < stages; s++)
+			{
+				f = f.then([](uint64_t x){ return stage(x); });
+			}
+			ends[c] = std::move(f);
+		}
+		for(auto& f : ends) { result += f.get(); }
+	}));
+
+	std::printf("(checksum %llu)\n", static_cast<unsigned long long>(result));
+}
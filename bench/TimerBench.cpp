@@ -0,0 +1,48 @@
+//cost of timed jobs: adding n timers spread over a minute to one pool, then
+//cancelling all of them, then adding n that are due within a second and
+//waiting for every one of them to run
+//usage: TimerBench [timers] [threads]
+#include <cstdlib>
+#include <stop_token>
+#include <vector>
+
+#include "Bench.h"
+#include "ThreadPool.h"
+
+using namespace avenir;
+
+int main(int argc, char** argv)
+{
+	size_t count = argc > 1 ? std::atoll(argv[1]) : 1000000;
+	uint32_t threads = argc > 2 ? std::atoi(argv[2]) : bench::defaultThreads();
+	
+	ThreadPool pool(threads);
+	std::vector<Future<void>> futures;
+	futures.reserve(count);
+	
+	std::stop_source source;
+	double scheduled = bench::timeIt([&]{
+		for(size_t i = 0; i < count; i++)
+		{
+			futures.push_back(pool.pushJobAfter(source.get_token(), std::chrono::milliseconds(1000 + i % 59000), []{}));
+		}
+	});
+	std::printf("%-40s %10.1f ns/timer\n", "schedule, 1s to 60s out", scheduled * 1e9 / count);
+	
+	double cancelled = bench::timeIt([&]{
+		source.request_stop();
+		for(auto& f : futures) { f.wait(); }
+	});
+	std::printf("%-40s %10.1f ns/timer\n", "cancel all", cancelled * 1e9 / count);
+	futures.clear();
+	
+	auto start = std::chrono::steady_clock::now();
+	double fired = bench::timeIt([&]{
+		for(size_t i = 0; i < count; i++)
+		{
+			futures.push_back(pool.pushJobAt(start + std::chrono::microseconds(i * 1000000 / count), []{}));
+		}
+		for(auto& f : futures) { f.wait(); }
+	});
+	std::printf("%-40s %10.3f s for a 1s spread\n", "schedule and run", fired);
+}
@@ -0,0 +1,86 @@
+//latency from the first of several promises being set until the waiter sees
+//it: spinning on isReady() over every input, blocking on whenAny().get(), and
+//a whenAny().then() continuation that runs on the completing thread
+//usage: WhenAnyBench [inputs] [rounds]
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "Bench.h"
+#include "ThreadPool.h"
+
+using namespace avenir;
+
+typedef std::chrono::steady_clock Clock;
+
+//sets one random input from a pool thread and returns when it was set
+static Future<Clock::time_point> setOne(ThreadPool& pool, std::vector<Promise<int>>& promises, std::mt19937& rng)
+{
+	size_t winner = rng() % promises.size();
+	return pool.pushJob([&promises, winner]{
+		Clock::time_point start = Clock::now();
+		promises[winner].setValue(1);
+		return start;
+	});
+}
+
+static void reportLatency(const char* name, double totalSeconds, uint64_t rounds)
+{
+	std::printf("%-48s %10.1f ns avg latency\n", name, totalSeconds * 1e9 / rounds);
+}
+
+int main(int argc, char** argv)
+{
+	size_t inputs = argc > 1 ? std::atoi(argv[1]) : 8;
+	uint64_t rounds = argc > 2 ? std::atoll(argv[2]) : 20000;
+	ThreadPool pool(1);
+	std::mt19937 rng(5);
+
+	double total = 0;
+	for(uint64_t r = 0; r < rounds; r++)
+	{
+		std::vector<Promise<int>> promises(inputs);
+		std::vector<Future<int>> futures;
+		for(auto& promise : promises) { futures.push_back(promise.getFuture()); }
+
+		Future<Clock::time_point> start = setOne(pool, promises, rng);
+		bool done = false;
+		while(!done)
+		{
+			for(auto& future : futures) { done = done || future.isReady(); }
+		}
+		std::chrono::duration<double> latency = Clock::now() - start.get();
+		total += latency.count();
+	}
+	reportLatency("poll isReady() on every input", total, rounds);
+
+	total = 0;
+	for(uint64_t r = 0; r < rounds; r++)
+	{
+		std::vector<Promise<int>> promises(inputs);
+		std::vector<Future<int>> futures;
+		for(auto& promise : promises) { futures.push_back(promise.getFuture()); }
+
+		auto any = whenAny(futures);
+		Future<Clock::time_point> start = setOne(pool, promises, rng);
+		any.wait();
+		std::chrono::duration<double> latency = Clock::now() - start.get();
+		total += latency.count();
+	}
+	reportLatency("whenAny().wait()", total, rounds);
+
+	total = 0;
+	for(uint64_t r = 0; r < rounds; r++)
+	{
+		std::vector<Promise<int>> promises(inputs);
+		std::vector<Future<int>> futures;
+		for(auto& promise : promises) { futures.push_back(promise.getFuture()); }
+
+		auto seen = whenAny(futures).then([](auto&){ return Clock::now(); });
+		Future<Clock::time_point> start = setOne(pool, promises, rng);
+		std::chrono::duration<double> latency = seen.get() - start.get();
+		total += latency.count();
+	}
+	reportLatency("whenAny().then(f), f runs on the setting thread", total, rounds);
+}
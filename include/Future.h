@@ -1,6 +1,20 @@
 #pragma once
 #include <atomic>
-#include <memory>
+#include <chrono>
+#include <concepts>
+#include <cstdint>
+#include <exception>
+#include <future>
+#include <new>
+#include <ranges>
+#include <stop_token>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "SpinWait.h"
+#include "Task.h"
 
 namespace avenir
 {
@@ -9,125 +23,940 @@ template <typename T>
 class Promise;
 
 template <typename T>
-class Future
+class Future;
+
+template <typename T>
+Future<T> makeReadyFuture(T val);
+
+Future<void> makeReadyFuture();
+
+template <typename T>
+Future<T> makeExceptionalFuture(std::exception_ptr error);
+
+enum class FutureStatus { Ready, Timeout };
+
+//what a future holds when the job or continuation that would have produced
+//its value was cancelled before it started
+class CancelledError : public std::exception
+{
+public:
+	const char* what() const noexcept override { return "avenir: cancelled before it ran"; }
+};
+
+namespace detail
+{
+
+inline std::exception_ptr cancelledError()
+{
+	return std::make_exception_ptr(CancelledError());
+}
+
+}
+
+//anything jobs can be posted to, like a ThreadPool
+template <typename E>
+concept Executor = requires(E& exec, Task job) { exec.post(std::move(job)); };
+
+namespace detail
+{
+
+template <typename T>
+class PromiseBase;
+
+template <typename State>
+class FutureBase;
+
+struct FutureAccess;
+
+//blocks while word == expected, spurious returns are allowed. futex based on
+//linux, elsewhere the untimed calls use std::atomic wait/notify and the timed
+//one spins, then sleeps with a growing backoff
+void futexWait(std::atomic<uint32_t>& word, uint32_t expected);
+//false if deadline passed
+bool futexWaitUntil(std::atomic<uint32_t>& word, uint32_t expected,
+	std::chrono::steady_clock::time_point deadline);
+void futexWakeAll(std::atomic<uint32_t>& word);
+
+//one registered continuation. the first one a state gets lives inside the
+//state, any further ones are allocated
+struct ContinuationNode
+{
+	Task job;
+	ContinuationNode* next = nullptr;
+};
+
+//everything a promise and its futures share lives in one allocation: the
+//reference count, the flags, the result and the continuations. a future is
+//just a pointer to it, unless it was made ready up front with a small value
+struct FutureStateBase
+{
+	typedef void Value;
+
+	virtual ~FutureStateBase()
+	{
+		//only non empty if the state is destroyed without ever becoming ready
+		ContinuationNode* node = continuations.load(std::memory_order_acquire);
+		if(node == fired()) { return; }
+		while(node != nullptr) { freeNode(std::exchange(node, node->next)); }
+	}
+
+	void addRef() { ref_count.fetch_add(1, std::memory_order_relaxed); }
+
+	void release()
+	{
+		if(ref_count.fetch_sub(1, std::memory_order_acq_rel) == 1) { delete this; }
+	}
+
+	//call once the result has been written, wakes waiters and fires the
+	//continuations in the order they were registered
+	void markReady()
+	{
+		//only waiters that announced themselves cost a wake up
+		if(ready_state.exchange(IsReady, std::memory_order_acq_rel) == HasWaiters)
+		{
+			futexWakeAll(ready_state);
+		}
+
+		ContinuationNode* node = continuations.exchange(fired(), std::memory_order_acq_rel);
+		ContinuationNode* ordered = nullptr;
+		while(node != nullptr)
+		{
+			ContinuationNode* next = node->next;
+			node->next = ordered;
+			ordered = node;
+			node = next;
+		}
+		while(ordered != nullptr)
+		{
+			ContinuationNode* next = ordered->next;
+			runNode(ordered);
+			ordered = next;
+		}
+	}
+
+	//runs f once the state is ready, right away if it already is. any number
+	//of continuations can be registered, from any thread, pushed onto a lock
+	//free stack that markReady swaps out
+	void onReady(Task&& f)
+	{
+		ContinuationNode* node = first_taken.exchange(true, std::memory_order_relaxed)
+			? new ContinuationNode() : &first_continuation;
+		node->job = std::move(f);
+
+		ContinuationNode* head = continuations.load(std::memory_order_acquire);
+		do
+		{
+			if(head == fired())
+			{
+				runNode(node);
+				return;
+			}
+			node->next = head;
+		}
+		while(!continuations.compare_exchange_weak(head, node, std::memory_order_acq_rel, std::memory_order_acquire));
+	}
+
+	bool isReady() const { return ready_state.load(std::memory_order_acquire) == IsReady; }
+
+	//spins for a while first, a result that is only microseconds away is
+	//cheaper to wait for awake than through a sleep and a wake up
+	void wait()
+	{
+		if(AdaptiveSpinner::forThisThread().spin([this]{ return isReady(); })) { return; }
+		while(announceWaiter()) { futexWait(ready_state, HasWaiters); }
+	}
+
+	//false if deadline passed first
+	bool waitUntil(std::chrono::steady_clock::time_point deadline)
+	{
+		while(announceWaiter())
+		{
+			if(!futexWaitUntil(ready_state, HasWaiters, deadline)) { return isReady(); }
+		}
+		return true;
+	}
+
+	enum : uint32_t { NotReady, IsReady, HasWaiters };
+
+	std::atomic<uint32_t> ref_count = 1;
+	std::atomic<uint32_t> ready_state = NotReady;
+	std::atomic<bool> first_taken = false;
+	bool has_error = false;
+	std::exception_ptr error;
+	//the stack of continuations waiting for markReady, fired() once it ran
+	std::atomic<ContinuationNode*> continuations = nullptr;
+	ContinuationNode first_continuation;
+private:
+	static ContinuationNode* fired() { return reinterpret_cast<ContinuationNode*>(uintptr_t(1)); }
+
+	//false once ready, otherwise makes sure markReady will wake us
+	bool announceWaiter()
+	{
+		uint32_t state = ready_state.load(std::memory_order_acquire);
+		while(state == NotReady)
+		{
+			ready_state.compare_exchange_weak(state, HasWaiters, std::memory_order_acquire);
+		}
+		return state != IsReady;
+	}
+
+	void freeNode(ContinuationNode* node)
+	{
+		if(node != &first_continuation) { delete node; }
+	}
+
+	void runNode(ContinuationNode* node)
+	{
+		Task f = std::move(node->job);
+		freeNode(node);
+		f();
+	}
+};
+
+template <typename T>
+struct FutureState : FutureStateBase
+{
+	typedef T Value;
+
+	~FutureState() override
+	{
+		if(has_value) { value().~T(); }
+	}
+
+	T& value() { return *std::launder(reinterpret_cast<T*>(storage)); }
+
+	bool has_value = false;
+	alignas(T) unsigned char storage[sizeof(T)];
+};
+
+template <>
+struct FutureState<void> : FutureStateBase {};
+
+//ready values small enough to copy around cheaply skip the shared state and
+//live in the future itself
+template <typename T>
+constexpr bool storesInline = false;
+
+template <typename T>
+	requires std::is_trivially_copyable_v<T>
+constexpr bool storesInline<T> = sizeof(T) <= 2 * sizeof(void*);
+
+//empty for everything that can't be stored inline, so those futures stay a
+//single pointer
+template <typename T, bool = storesInline<T>>
+struct InlineValue
+{
+	static constexpr bool isSet() { return false; }
+	static T* get() { return nullptr; }
+};
+
+template <typename T>
+struct InlineValue<T, true>
+{
+	bool isSet() const { return set; }
+	T* get() { return std::launder(reinterpret_cast<T*>(storage)); }
+
+	bool set = false;
+	//zeroed so copying an empty one doesn't read uninitialised bytes
+	alignas(T) unsigned char storage[sizeof(T)] = {};
+};
+
+template <>
+struct InlineValue<void, false>
+{
+	bool isSet() const { return set; }
+	static void* get() { return nullptr; }
+
+	bool set = false;
+};
+
+//the reference counting and waiting shared by Future<T> and Future<void>
+template <typename State>
+class FutureBase
 {
 public:
-	Future(const Future<T>& oth)
-		: m_statePtr(oth.m_statePtr), m_dataPtr(oth.m_dataPtr) {}
-	
-	Future& operator=(const Future<T>& oth)
+	typedef typename State::Value Value;
+
+	FutureBase(const FutureBase& oth) : m_state(oth.m_state), m_inline(oth.m_inline)
+	{
+		if(m_state != nullptr) { m_state->addRef(); }
+	}
+
+	FutureBase& operator=(const FutureBase& oth)
 	{
-		m_statePtr = oth.m_statePtr;
-		m_dataPtr = oth.m_dataPtr;
+		FutureBase tmp(oth);
+		swap(tmp);
 		return *this;
 	}
-	
-	Future(Future<T>&& oth)
-		: m_statePtr(std::move(oth.m_statePtr)),
-		m_dataPtr(std::move(oth.m_dataPtr)) {}
-	
-	Future& operator=(Future<T>&& oth)
+
+	FutureBase(FutureBase&& oth) noexcept
+		: m_state(std::exchange(oth.m_state, nullptr)), m_inline(std::exchange(oth.m_inline, {})) {}
+
+	FutureBase& operator=(FutureBase&& oth) noexcept
 	{
-		m_statePtr = std::move(oth.m_statePtr);
-		m_dataPtr = std::move(oth.m_dataPtr);
+		FutureBase tmp(std::move(oth));
+		swap(tmp);
 		return *this;
 	}
 
-	bool isValid() const { return m_statePtr->valid_flag.test(); }
-	
-	bool isReady() const { return m_statePtr->ready_flag.test(); }
-	
-	void wait() { m_statePtr->ready_flag.wait(false); }
-	
+	~FutureBase()
+	{
+		if(m_state != nullptr) { m_state->release(); }
+	}
+
+	//false for a default constructed or moved from future
+	bool isValid() const { return m_state != nullptr || m_inline.isSet(); }
+
+	//these and get throw future_error(no_state) on an invalid future
+	bool isReady() const
+	{
+		if(m_inline.isSet()) { return true; }
+		checkState();
+		return m_state->isReady();
+	}
+
+	void wait() const
+	{
+		if(m_inline.isSet()) { return; }
+		checkState();
+		m_state->wait();
+	}
+
+	template <typename Rep, typename Period>
+	FutureStatus waitFor(const std::chrono::duration<Rep, Period>& timeout) const
+	{
+		return waitUntil(std::chrono::steady_clock::now() + timeout);
+	}
+
+	//deadlines on other clocks are rechecked against their own clock after
+	//every wake up, so adjusting the system clock is noticed eventually
+	template <typename Clock, typename Duration>
+	FutureStatus waitUntil(const std::chrono::time_point<Clock, Duration>& deadline) const
+	{
+		if(isReady()) { return FutureStatus::Ready; }
+
+		while(true)
+		{
+			auto now = Clock::now();
+			if(now >= deadline) { return isReady() ? FutureStatus::Ready : FutureStatus::Timeout; }
+
+			auto steadyDeadline = std::chrono::steady_clock::now()
+				+ std::chrono::ceil<std::chrono::steady_clock::duration>(deadline - now);
+			if(m_state->waitUntil(steadyDeadline)) { return FutureStatus::Ready; }
+		}
+	}
+
+	//returns a future for f(value), f(void) for Future<void>. f runs on the
+	//thread that completes this future, or right here if it already has, so
+	//it should be short. if this future holds an error f is skipped and the
+	//error is passed on. copies of a future can each add their own
+	template <typename F>
+	auto then(F&& f)
+	{
+		return runWhenReady(std::forward<F>(f));
+	}
+
+	//same as above but f is posted to exec once this future is ready, exec has
+	//to outlive the chain
+	template <Executor E, typename F>
+	auto then(E& exec, F&& f)
+	{
+		//the value has to outlive this future, so it moves into a shared state
+		if(m_inline.isSet()) { return toShared().postWhenReady(exec, std::forward<F>(f)); }
+		return postWhenReady(exec, std::forward<F>(f));
+	}
+
+	//cancellable versions: if token is stopped by the time f would run, f is
+	//skipped and the returned future holds a CancelledError. that error then
+	//skips every later stage of the chain like any other
+	template <typename F>
+	auto then(std::stop_token token, F&& f)
+	{
+		return runWhenReady(std::forward<F>(f), std::move(token));
+	}
+
+	template <Executor E, typename F>
+	auto then(E& exec, std::stop_token token, F&& f)
+	{
+		if(m_inline.isSet()) { return toShared().postWhenReady(exec, std::forward<F>(f), std::move(token)); }
+		return postWhenReady(exec, std::forward<F>(f), std::move(token));
+	}
+protected:
+	FutureBase() = default;
+
+	//takes over a reference the caller already holds
+	explicit FutureBase(State* state) noexcept : m_state(state) {}
+
+	void rethrowIfError() const
+	{
+		if(m_inline.isSet()) { return; }
+		if(m_state->has_error) { std::rethrow_exception(m_state->error); }
+	}
+
+	void checkState() const
+	{
+		if(m_state == nullptr) { throw std::future_error(std::future_errc::no_state); }
+	}
+
+	State* m_state = nullptr;
+	[[no_unique_address]] InlineValue<Value> m_inline;
+private:
+	friend struct FutureAccess;
+
+	void swap(FutureBase& oth) noexcept
+	{
+		std::swap(m_state, oth.m_state);
+		std::swap(m_inline, oth.m_inline);
+	}
+
+	//token is empty or a single std::stop_token, so uncancellable continuations
+	//don't carry one around
+	template <typename F, typename... Token>
+	auto runWhenReady(F&& f, Token... token)
+	{
+		typedef Result<F> R;
+
+		if(m_inline.isSet())
+		{
+			if((token.stop_requested() || ...)) { return makeExceptionalFuture<R>(cancelledError()); }
+			return invokeReady<R>(m_inline.get(), f);
+		}
+
+		checkState();
+		Promise<R> promise;
+		Future<R> next = promise.getFuture();
+		State* state = m_state;
+		//the promise or the future calling onReady keeps state alive while this runs
+		m_state->onReady(Task([state, f = std::forward<F>(f), promise = std::move(promise),
+			...token = std::move(token)]() mutable {
+			fulfil(state, f, promise, token...);
+		}));
+		return next;
+	}
+
+	template <Executor E, typename F, typename... Token>
+	auto postWhenReady(E& exec, F&& f, Token... token)
+	{
+		typedef Result<F> R;
+
+		checkState();
+		Promise<R> promise;
+		Future<R> next = promise.getFuture();
+		//the posted job holds its own reference, it may run after everyone else let go
+		m_state->onReady(Task([&exec, self = *this, f = std::forward<F>(f), promise = std::move(promise),
+			...token = std::move(token)]() mutable {
+			exec.post([self = std::move(self), f = std::move(f), promise = std::move(promise),
+				...token = std::move(token)]() mutable {
+				fulfil(self.m_state, f, promise, token...);
+			});
+		}));
+		return next;
+	}
+
+	static Value* valueOf(State* state)
+	{
+		if constexpr(std::is_void_v<Value>) { return nullptr; }
+		else { return &state->value(); }
+	}
+
+	//calls f with the value, or with nothing for Future<void>
+	template <typename F>
+	static decltype(auto) invokeWithValue(Value* value, F& f)
+	{
+		if constexpr(std::is_void_v<Value>) { return f(); }
+		else { return f(*value); }
+	}
+
+	template <typename F>
+	using Result = std::remove_cvref_t<decltype(invokeWithValue(std::declval<Value*>(), std::declval<std::decay_t<F>&>()))>;
+
+	//then on a value that is already here, no continuation to register
+	template <typename R, typename F>
+	static Future<R> invokeReady(Value* value, F& f)
+	{
+		try
+		{
+			if constexpr(std::is_void_v<R>)
+			{
+				invokeWithValue(value, f);
+				return makeReadyFuture();
+			}
+			else
+			{
+				return makeReadyFuture<R>(invokeWithValue(value, f));
+			}
+		}
+		catch(...)
+		{
+			return makeExceptionalFuture<R>(std::current_exception());
+		}
+	}
+
+	//the same ready value in a shared state
+	Future<Value> toShared()
+	{
+		Promise<Value> promise;
+		Future<Value> shared = promise.getFuture();
+		if constexpr(std::is_void_v<Value>) { promise.setValue(); }
+		else { promise.setValue(*m_inline.get()); }
+		return shared;
+	}
+
+	template <typename F, typename R, typename... Token>
+	static void fulfil(State* state, F& f, Promise<R>& promise, const Token&... token)
+	{
+		if(state->has_error)
+		{
+			promise.setException(state->error);
+			return;
+		}
+		if((token.stop_requested() || ...))
+		{
+			promise.setException(cancelledError());
+			return;
+		}
+		try
+		{
+			if constexpr(std::is_void_v<R>)
+			{
+				invokeWithValue(valueOf(state), f);
+				promise.setValue();
+			}
+			else
+			{
+				promise.setValue(invokeWithValue(valueOf(state), f));
+			}
+		}
+		catch(...)
+		{
+			promise.setException(std::current_exception());
+		}
+	}
+};
+
+}
+
+template <typename T>
+class Future : public detail::FutureBase<detail::FutureState<T>>
+{
+public:
+	Future() = default;
+
 	T& get()
 	{
-		m_statePtr->ready_flag.wait(false);
-		return *m_dataPtr;
+		if(this->m_inline.isSet()) { return *this->m_inline.get(); }
+
+		this->checkState();
+		this->wait();
+		this->rethrowIfError();
+		return this->m_state->value();
 	}
 private:
-	friend class Promise<T>;
-	
-	struct State
-	{
-		std::atomic_flag valid_flag;
-		std::atomic_flag ready_flag;
-	};
-	
-	std::shared_ptr<State> m_statePtr;
-	std::shared_ptr<T> m_dataPtr;
-	
+	friend class detail::PromiseBase<T>;
+	friend class Future<void>;
+	friend struct detail::FutureAccess;
+
 	//private constructor since only a promise can create a future
-	Future(std::shared_ptr<State>& statePtr, std::shared_ptr<T>& dataPtr)
-		: m_statePtr(statePtr), m_dataPtr(dataPtr) {}
+	explicit Future(detail::FutureState<T>* state)
+		: detail::FutureBase<detail::FutureState<T>>(state) {}
 };
 
+//a Future<void> can also be made from any other future, it then only
+//tracks completion and errors
 template<>
-class Future<void>
+class Future<void> : public detail::FutureBase<detail::FutureStateBase>
 {
 public:
+	Future() = default;
+
 	template<typename U>
-	Future(const Future<U>& oth) : m_statePtr(oth.m_statePtr) {}
-	
+	Future(const Future<U>& oth) : FutureBase(oth.m_state)
+	{
+		if(m_state != nullptr) { m_state->addRef(); }
+		m_inline.set = oth.m_inline.isSet();
+	}
+
 	template<typename U>
 	Future& operator=(const Future<U>& oth)
 	{
-		m_statePtr = oth.m_statePtr;
-		return *this;
+		return *this = Future(oth);
 	}
-	
+
 	template<typename U>
-	Future(Future<U>&& oth) : m_statePtr(std::move(oth.m_statePtr)) {}
-	
+	Future(Future<U>&& oth) noexcept : FutureBase(std::exchange(oth.m_state, nullptr))
+	{
+		m_inline.set = std::exchange(oth.m_inline, {}).isSet();
+	}
+
 	template <typename U>
-	Future& operator=(Future<U>&& oth)
+	Future& operator=(Future<U>&& oth) noexcept
 	{
-		m_statePtr = std::move(oth.m_statePtr);
-		return *this;
+		return *this = Future(std::move(oth));
 	}
-	
-	bool isValid() const { return m_statePtr->valid_flag.test(); }
-	
-	bool isReady() const { return m_statePtr->ready_flag.test(); }
-	
-	void wait() { m_statePtr->ready_flag.wait(false); }
-	
+
 	void get()
 	{
-		m_statePtr->ready_flag.wait(false);
+		wait();
+		rethrowIfError();
 	}
 private:
-	friend class Promise<void>;
-	
-	struct State
-	{
-		std::atomic_flag valid_flag;
-		std::atomic_flag ready_flag;
-	};
-	
-	std::shared_ptr<State> m_statePtr;
-	
+	friend class detail::PromiseBase<void>;
+	friend struct detail::FutureAccess;
+
 	//private constructor since only a promise can create a future
-	Future(std::shared_ptr<State>& statePtr);
+	explicit Future(detail::FutureStateBase* state);
 };
 
+namespace detail
+{
+
+//the parts of Promise<T> that don't depend on how the value is set
 template <typename T>
-class Promise
+class PromiseBase
 {
 public:
+	PromiseBase(const PromiseBase& other) = delete; //no copy constructor
+	PromiseBase& operator= (const PromiseBase& other) = delete; //no copy assignment
+
+	PromiseBase(PromiseBase&& oth) noexcept
+		: m_state(std::exchange(oth.m_state, nullptr)),
+		m_futureRetrieved(oth.m_futureRetrieved), m_satisfied(oth.m_satisfied) {}
+
+	PromiseBase& operator= (PromiseBase&& oth) noexcept
+	{
+		abandon();
+		m_state = std::exchange(oth.m_state, nullptr);
+		m_futureRetrieved = oth.m_futureRetrieved;
+		m_satisfied = oth.m_satisfied;
+		return *this;
+	}
+
+	//an unsatisfied promise leaves a broken_promise future_error behind
+	~PromiseBase() { abandon(); }
+
+	//can only be called once per promise
+	Future<T> getFuture()
+	{
+		checkState();
+		if(m_futureRetrieved) { throw std::future_error(std::future_errc::future_already_retrieved); }
+		m_futureRetrieved = true;
+		m_state->addRef();
+		return Future<T>(m_state);
+	}
+
+	void setException(std::exception_ptr error)
+	{
+		checkUnsatisfied();
+		m_state->error = std::move(error);
+		m_state->has_error = true;
+		publish();
+	}
+protected:
+	PromiseBase() : m_state(new FutureState<T>()) {}
+
+	//throws if there is no result left to set
+	void checkUnsatisfied() const
+	{
+		checkState();
+		if(m_satisfied) { throw std::future_error(std::future_errc::promise_already_satisfied); }
+	}
+
+	//only called once the result is fully written, so a value constructor that
+	//throws leaves the promise free to take an exception instead
+	void publish()
+	{
+		m_satisfied = true;
+		m_state->markReady();
+	}
+
+	FutureState<T>* m_state;
 private:
+	void checkState() const
+	{
+		if(m_state == nullptr) { throw std::future_error(std::future_errc::no_state); }
+	}
+
+	void abandon()
+	{
+		if(m_state == nullptr) { return; }
+		if(!m_satisfied)
+		{
+			m_state->error = std::make_exception_ptr(std::future_error(std::future_errc::broken_promise));
+			m_state->has_error = true;
+			m_state->markReady();
+		}
+		m_state->release();
+		m_state = nullptr;
+	}
+
+	bool m_futureRetrieved = false;
+	bool m_satisfied = false;
+};
+
+}
+
+//the writing end of a Future. the result is written into the shared state
+//and published with a release on ready_state, which every reader acquires
+template <typename T>
+class Promise : public detail::PromiseBase<T>
+{
+public:
+	Promise() = default;
+
+	//constructs the value in place from args
+	template <typename... Args>
+		requires std::constructible_from<T, Args...>
+	void setValue(Args&&... args)
+	{
+		this->checkUnsatisfied();
+		::new (static_cast<void*>(this->m_state->storage)) T(std::forward<Args>(args)...);
+		this->m_state->has_value = true;
+		this->publish();
+	}
 };
 
 template<>
-class Promise<void>
+class Promise<void> : public detail::PromiseBase<void>
 {
 public:
-private:
+	Promise() = default;
+
+	void setValue()
+	{
+		checkUnsatisfied();
+		publish();
+	}
 };
 
+namespace detail
+{
+
+//lets the combinators build futures around shared states of their own
+struct FutureAccess
+{
+	//takes over a reference the caller already holds
+	template <typename T, typename State>
+	static Future<T> adopt(State* state) { return Future<T>(state); }
+
+	template <typename F>
+	static auto* state(const F& future) { return future.m_state; }
+
+	//true for a ready future with its value stored inline and no shared state
+	template <typename F>
+	static bool isInline(const F& future) { return future.m_inline.isSet(); }
+
+	template <typename T, typename... Args>
+	static Future<T> makeInline(Args&&... args)
+	{
+		Future<T> future;
+		if constexpr(!std::is_void_v<T>)
+		{
+			::new (static_cast<void*>(future.m_inline.storage)) T(std::forward<Args>(args)...);
+		}
+		future.m_inline.set = true;
+		return future;
+	}
+};
+
+//the shared state of a combined future, ready once every input has arrived.
+//the countdown owns one reference that the last arrival gives up
+template <typename T>
+struct CountdownState : FutureState<T>
+{
+	explicit CountdownState(uint32_t count) : remaining(count) {}
+
+	void arrive()
+	{
+		if(remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			this->markReady();
+			this->release();
+		}
+	}
+
+	std::atomic<uint32_t> remaining;
+};
+
+//value has to already hold the inputs, forEach(f) calls f on each of them
+template <typename T, typename ForEach>
+Future<T> whenAll(T&& value, uint32_t count, ForEach&& forEach)
+{
+	//one extra arrival for ourselves so nothing is ready halfway through registering
+	auto* state = new CountdownState<T>(count + 1);
+	::new (static_cast<void*>(state->storage)) T(std::move(value));
+	state->has_value = true;
+	state->addRef(); //for the returned future
+
+	forEach(state->value(), [state](auto& input){
+		if(FutureAccess::isInline(input)) { state->arrive(); }
+		else { FutureAccess::state(input)->onReady(Task([state]{ state->arrive(); })); }
+	});
+	state->arrive();
+	return FutureAccess::adopt<T>(state);
+}
+
+template <typename T>
+constexpr bool isFuture = false;
+
+template <typename T>
+constexpr bool isFuture<Future<T>> = true;
+
+template <typename F>
+struct FutureValue;
+
+template <typename T>
+struct FutureValue<Future<T>> { typedef T Type; };
+
+template <typename F>
+void checkInput(const F& future)
+{
+	if(!future.isValid()) { throw std::future_error(std::future_errc::no_state); }
+}
+
+}
+
+//a future that becomes ready once all of futures are, holding the inputs so
+//each one's value or error can be read from it. it adds a continuation to
+//every input and allocates one shared state, no thread waits. an input may
+//be passed more than once or have other continuations of its own
+template <typename... Ts>
+Future<std::tuple<Future<Ts>...>> whenAll(Future<Ts>... futures)
+{
+	(detail::checkInput(futures), ...);
+	return detail::whenAll(std::tuple<Future<Ts>...>(std::move(futures)...), sizeof...(Ts),
+		[](auto& inputs, auto&& registerInput){
+			std::apply([&](auto&... input){ (registerInput(input), ...); }, inputs);
+		});
+}
+
+//same as above for a range of futures of the same type
+template <std::ranges::input_range Range>
+	requires detail::isFuture<std::ranges::range_value_t<Range>>
+auto whenAll(Range&& futures) -> Future<std::vector<std::ranges::range_value_t<Range>>>
+{
+	std::vector<std::ranges::range_value_t<Range>> inputs;
+	for(auto&& future : futures)
+	{
+		detail::checkInput(future);
+		inputs.push_back(std::forward<decltype(future)>(future));
+	}
+
+	uint32_t count = static_cast<uint32_t>(inputs.size());
+	return detail::whenAll(std::move(inputs), count,
+		[](auto& inputs, auto&& registerInput){
+			for(auto& input : inputs) { registerInput(input); }
+		});
+}
+
+namespace detail
+{
+
+//the shared state of whenAny. every input's continuation holds a reference
+//and the first one to claim the winner slot sets the value
+template <typename T>
+struct FirstState : FutureState<std::pair<size_t, Future<T>>>
+{
+	typedef T Input;
+	typedef std::pair<size_t, Future<T>> Value;
+
+	static constexpr size_t NoWinner = static_cast<size_t>(-1);
+
+	//called by input index as it becomes ready, makeInput is only called by the winner
+	template <typename MakeInput>
+	void arrive(size_t index, MakeInput&& makeInput)
+	{
+		size_t expected = NoWinner;
+		if(winner.load(std::memory_order_relaxed) == NoWinner
+			&& winner.compare_exchange_strong(expected, index, std::memory_order_acq_rel))
+		{
+			::new (static_cast<void*>(this->storage)) Value(index, makeInput());
+			this->has_value = true;
+			this->markReady();
+		}
+		this->release();
+	}
+
+	std::atomic<size_t> winner = NoWinner;
+};
+
+}
+
+//a future for the first of futures to become ready: its index in the range
+//and the input itself. like whenAll it adds a continuation to every input
+//and allocates one shared state, the losers can still be chained with then
+//and it is freed once the last of them is ready. an empty range gives a
+//ready future with index size_t(-1) and an invalid input
+template <std::ranges::forward_range Range>
+	requires detail::isFuture<std::ranges::range_value_t<Range>>
+auto whenAny(Range&& futures)
+{
+	typedef detail::FirstState<typename detail::FutureValue<std::ranges::range_value_t<Range>>::Type> State;
+
+	for(auto& future : futures) { detail::checkInput(future); }
+
+	auto* state = new State();
+	size_t index = 0;
+	for(auto& future : futures)
+	{
+		state->addRef(); //released by arrive
+		if(detail::FutureAccess::isInline(future))
+		{
+			state->arrive(index, [&future]{ return future; });
+		}
+		else
+		{
+			//the input is alive while its continuation runs
+			auto* input = detail::FutureAccess::state(future);
+			input->onReady(Task([state, index, input]{
+				state->arrive(index, [input]{
+					input->addRef();
+					return detail::FutureAccess::adopt<typename State::Input>(input);
+				});
+			}));
+		}
+		index++;
+	}
+
+	if(index == 0)
+	{
+		::new (static_cast<void*>(state->storage)) typename State::Value(State::NoWinner, {});
+		state->has_value = true;
+		state->markReady();
+	}
+	return detail::FutureAccess::adopt<typename State::Value>(state);
+}
+
+//a future that is already ready with val. small trivially copyable values are
+//kept in the future itself, anything else costs one shared state
 template <typename T>
 Future<T> makeReadyFuture(T val)
 {
+	if constexpr(detail::storesInline<T>)
+	{
+		return detail::FutureAccess::makeInline<T>(val);
+	}
+	else
+	{
+		Promise<T> promise;
+		Future<T> future = promise.getFuture();
+		promise.setValue(std::move(val));
+		return future;
+	}
+}
 
+inline Future<void> makeReadyFuture()
+{
+	return detail::FutureAccess::makeInline<void>();
+}
+
+//a ready future holding error
+template <typename T>
+Future<T> makeExceptionalFuture(std::exception_ptr error)
+{
+	Promise<T> promise;
+	Future<T> future = promise.getFuture();
+	promise.setException(std::move(error));
+	return future;
 }
 
 }
@@ -0,0 +1,148 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+namespace avenir
+{
+
+//bounded lock free multi producer multi consumer queue (Vyukov). every cell
+//has a sequence number telling producers and consumers whose turn it is, so
+//claiming a slot is a single CAS on the head or tail and nothing allocates
+//after construction
+template <typename T>
+class MPMCQueue
+{
+public:
+	//capacity must be a power of two
+	explicit MPMCQueue(uint32_t capacity = 4096)
+		: m_mask(capacity - 1), m_cells(new Cell[capacity])
+	{
+		for(uint32_t i = 0; i < capacity; i++)
+		{
+			m_cells[i].seq.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	MPMCQueue(const MPMCQueue& other) = delete;
+	MPMCQueue& operator= (const MPMCQueue& other) = delete;
+
+	//returns false and leaves val alone if the queue is full
+	bool tryPush(T&& val)
+	{
+		uint64_t pos = m_tail.load(std::memory_order_relaxed);
+		while(true)
+		{
+			Cell& cell = m_cells[pos & m_mask];
+			uint64_t seq = cell.seq.load(std::memory_order_acquire);
+			int64_t diff = static_cast<int64_t>(seq - pos);
+			if(diff == 0)
+			{
+				if(m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					cell.value.emplace(std::move(val));
+					cell.seq.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if(diff < 0) //the consumer from the previous lap hasn't finished
+			{
+				return false;
+			}
+			else
+			{
+				pos = m_tail.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	//all or nothing, claims count consecutive cells with a single CAS on the
+	//tail. on success the values have been moved from, on failure they are untouched
+	bool tryPushBulk(T* vals, uint32_t count)
+	{
+		if(count > m_mask + 1) { return false; }
+		
+		uint64_t pos = m_tail.load(std::memory_order_relaxed);
+		while(true)
+		{
+			uint32_t free = 0;
+			while(free < count && m_cells[(pos + free) & m_mask].seq.load(std::memory_order_acquire) == pos + free)
+			{
+				free++;
+			}
+			
+			if(free < count)
+			{
+				uint64_t tail = m_tail.load(std::memory_order_relaxed);
+				if(tail == pos) { return false; } //not enough room
+				pos = tail;
+			}
+			else if(m_tail.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed))
+			{
+				break;
+			}
+		}
+		
+		//nobody else can write these cells until we publish them
+		for(uint32_t i = 0; i < count; i++)
+		{
+			Cell& cell = m_cells[(pos + i) & m_mask];
+			cell.value.emplace(std::move(vals[i]));
+			cell.seq.store(pos + i + 1, std::memory_order_release);
+		}
+		return true;
+	}
+
+	std::optional<T> tryPop()
+	{
+		uint64_t pos = m_head.load(std::memory_order_relaxed);
+		while(true)
+		{
+			Cell& cell = m_cells[pos & m_mask];
+			uint64_t seq = cell.seq.load(std::memory_order_acquire);
+			int64_t diff = static_cast<int64_t>(seq - (pos + 1));
+			if(diff == 0)
+			{
+				if(m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					std::optional<T> val(std::move(cell.value));
+					cell.value.reset();
+					cell.seq.store(pos + m_mask + 1, std::memory_order_release);
+					return val;
+				}
+			}
+			else if(diff < 0) //empty, or the producer hasn't finished writing
+			{
+				return std::nullopt;
+			}
+			else
+			{
+				pos = m_head.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	//only a snapshot, it may be stale as soon as it returns
+	uint32_t size() const
+	{
+		uint64_t tail = m_tail.load(std::memory_order_relaxed);
+		uint64_t head = m_head.load(std::memory_order_relaxed);
+		return tail > head ? static_cast<uint32_t>(tail - head) : 0;
+	}
+
+	uint32_t capacity() const { return static_cast<uint32_t>(m_mask + 1); }
+private:
+	struct Cell
+	{
+		std::atomic<uint64_t> seq;
+		std::optional<T> value;
+	};
+
+	alignas(64) std::atomic<uint64_t> m_head = 0;
+	alignas(64) std::atomic<uint64_t> m_tail = 0;
+	alignas(64) const uint64_t m_mask;
+	std::unique_ptr<Cell[]> m_cells;
+};
+
+}
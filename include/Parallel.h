@@ -0,0 +1,550 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <concepts>
+#include <iterator>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <ranges>
+#include <vector>
+#include <type_traits>
+
+#include "ThreadPool.h"
+#include "TaskGroup.h"
+
+namespace avenir
+{
+
+//how the parallel algorithms hand out pieces of a range to threads
+enum class Schedule
+{
+	Static, //one equal block per thread, cheapest when every iteration costs the same
+	Dynamic, //threads keep grabbing grain sized chunks from a shared counter
+	Guided, //like Dynamic, but chunks start big and shrink as the range runs out
+	Adaptive //lazy binary splitting, a range is only halved while the pool has nothing queued
+};
+
+//how the reductions combine partial results
+enum class Reduction
+{
+	Fast, //each thread folds whatever chunks it claims into its own accumulator
+	Deterministic //fixed blocks combined in a fixed pairwise tree, same answer every run
+};
+
+namespace detail
+{
+
+//hands out [next, end) in chunks for the Dynamic and Guided schedules
+template <typename Index>
+struct ChunkCounter
+{
+	ChunkCounter(Index begin, Index end, Index grain, uint32_t threads, Schedule schedule)
+		: next(begin), end(end), grain(grain), threads(threads), schedule(schedule) {}
+
+	std::atomic<Index> next;
+	const Index end;
+	const Index grain;
+	const uint32_t threads;
+	const Schedule schedule;
+
+	bool claim(Index& lo, Index& hi)
+	{
+		lo = next.load(std::memory_order_relaxed);
+		Index size;
+		do
+		{
+			if(lo >= end) { return false; }
+			Index remaining = end - lo;
+			size = grain;
+			if(schedule == Schedule::Guided)
+			{
+				size = std::max<Index>(grain, remaining / static_cast<Index>(threads * 2));
+			}
+			size = std::min(size, remaining);
+		} while(!next.compare_exchange_weak(lo, lo + size, std::memory_order_relaxed));
+
+		hi = lo + size;
+		return true;
+	}
+};
+
+template <typename Index, typename Body>
+struct ForState : JoinState
+{
+	ForState(ThreadPool& pool, Body& body, Index begin, Index end, Index grain,
+		uint32_t threads, Schedule schedule)
+		: pool(pool), body(body), grain(grain), chunks(begin, end, grain, threads, schedule) {}
+
+	ThreadPool& pool;
+	Body& body;
+	const Index grain;
+	ChunkCounter<Index> chunks;
+
+	void run(Index lo, Index hi)
+	{
+		if(failed.load(std::memory_order_relaxed)) { return; }
+		try
+		{
+			for(Index i = lo; i < hi; i++) { body(i); }
+		}
+		catch(...) { fail(); }
+	}
+
+	//Dynamic and Guided, keep claiming chunks until the counter runs out
+	void runShared()
+	{
+		Index lo, hi;
+		while(!failed.load(std::memory_order_relaxed) && chunks.claim(lo, hi))
+		{
+			run(lo, hi);
+		}
+	}
+};
+
+template <typename Index, typename Body>
+void runAdaptive(const std::shared_ptr<ForState<Index, Body>>& state, Index lo, Index hi)
+{
+	ForState<Index, Body>& s = *state;
+	while(hi - lo > s.grain && !s.failed.load(std::memory_order_relaxed))
+	{
+		if(s.pool.jobsRemaining() == 0)
+		{
+			//nobody has spare work to steal, give them our upper half
+			Index mid = lo + (hi - lo) / 2;
+			s.pending++;
+			PoolAccess::post(s.pool, [state, mid, hi]{
+				runAdaptive(state, mid, hi);
+				state->finish();
+			});
+			hi = mid;
+		}
+		else
+		{
+			s.run(lo, lo + s.grain);
+			lo += s.grain;
+		}
+	}
+	s.run(lo, hi);
+}
+
+//acc starts out empty so no identity value is needed
+template <typename T, typename It, typename Reduce, typename Transform>
+void fold(std::optional<T>& acc, It first, std::iter_difference_t<It> lo,
+	std::iter_difference_t<It> hi, Reduce& reduce, Transform& transform)
+{
+	if(lo >= hi) { return; }
+	if(!acc)
+	{
+		acc.emplace(transform(first[lo]));
+		lo++;
+	}
+
+	//fold into a plain local so the loop doesn't go through the optional
+	T value = std::move(*acc);
+	for(auto i = lo; i < hi; i++)
+	{
+		value = reduce(std::move(value), transform(first[i]));
+	}
+	*acc = std::move(value);
+}
+
+//one accumulator per participating thread, padded so neighbours never share a cache line
+template <typename T>
+struct alignas(64) Partial
+{
+	std::optional<T> value;
+};
+
+template <typename T, typename It, typename Reduce, typename Transform>
+struct ReduceState : JoinState
+{
+	typedef std::iter_difference_t<It> Index;
+
+	ReduceState(It first, Reduce& reduce, Transform& transform, Index count, Index grain, uint32_t threads)
+		: first(first), reduce(reduce), transform(transform),
+		chunks(0, count, grain, threads, Schedule::Dynamic), partials(new Partial<T>[threads]) {}
+
+	It first;
+	Reduce& reduce;
+	Transform& transform;
+	ChunkCounter<Index> chunks;
+	std::unique_ptr<Partial<T>[]> partials;
+
+	void runSlot(uint32_t slot)
+	{
+		Index lo, hi;
+		while(!failed.load(std::memory_order_relaxed) && chunks.claim(lo, hi))
+		{
+			try { fold(partials[slot].value, first, lo, hi, reduce, transform); }
+			catch(...) { fail(); }
+		}
+	}
+};
+
+//L2 size of the machine, or a conservative guess if the OS won't say
+size_t l2CacheSize();
+
+//scan [lo, hi) into out starting from carry, which is empty only for the
+//first block of an inclusive scan without an init value
+template <typename T, typename InIt, typename OutIt, typename Op>
+void scanBlock(InIt first, OutIt out, std::iter_difference_t<InIt> lo,
+	std::iter_difference_t<InIt> hi, Op& op, std::optional<T> carry, bool inclusive)
+{
+	if(lo >= hi) { return; }
+	if(!carry)
+	{
+		carry.emplace(first[lo]);
+		out[lo] = *carry;
+		lo++;
+	}
+
+	T acc = std::move(*carry);
+	for(auto i = lo; i < hi; i++)
+	{
+		if(inclusive)
+		{
+			acc = op(std::move(acc), first[i]);
+			out[i] = acc;
+		}
+		else
+		{
+			//read before writing so out may alias first
+			T val = first[i];
+			out[i] = acc;
+			acc = op(std::move(acc), std::move(val));
+		}
+	}
+}
+
+//two passes over L2 sized blocks: reduce every block in parallel, scan the
+//block totals serially, then scan every block again from its carry in parallel
+template <typename T, typename InIt, typename OutIt, typename Op>
+OutIt scan(ThreadPool& pool, InIt first, InIt last, OutIt out, Op& op,
+	std::optional<T> init, bool inclusive)
+{
+	typedef std::iter_difference_t<InIt> Index;
+
+	Index count = last - first;
+	if(count <= 0) { return out; }
+
+	//input and output of one block together fill half of L2
+	Index blockSize = std::max<Index>(1024, l2CacheSize() / (4 * sizeof(T)));
+	Index blocks = (count + blockSize - 1) / blockSize;
+	if(blocks == 1 || pool.getThreadCount() == 0)
+	{
+		scanBlock<T>(first, out, Index(0), count, op, std::move(init), inclusive);
+		return out + count;
+	}
+
+	std::vector<std::optional<T>> carries(blocks);
+	std::identity identity;
+	parallelFor(pool, Index(0), blocks - 1, [&](Index b){
+		fold(carries[b + 1], first, b * blockSize, (b + 1) * blockSize, op, identity);
+	}, Schedule::Dynamic, Index(1));
+
+	//turn the block totals into the value carried into each block
+	carries[0] = std::move(init);
+	for(Index b = 1; b < blocks; b++)
+	{
+		if(carries[b - 1])
+		{
+			carries[b].emplace(op(*carries[b - 1], std::move(*carries[b])));
+		}
+	}
+
+	parallelFor(pool, Index(0), blocks, [&](Index b){
+		scanBlock<T>(first, out, b * blockSize, std::min(count, (b + 1) * blockSize),
+			op, carries[b], inclusive);
+	}, Schedule::Dynamic, Index(1));
+
+	return out + count;
+}
+
+//merge path split: how many of the first k merged elements come from a, so
+//that equal elements from a still come before those from b
+template <typename It, typename Comp>
+std::iter_difference_t<It> coRank(std::iter_difference_t<It> k, It a, std::iter_difference_t<It> aLen,
+	It b, std::iter_difference_t<It> bLen, Comp& comp)
+{
+	std::iter_difference_t<It> lo = std::max<std::iter_difference_t<It>>(0, k - bLen);
+	std::iter_difference_t<It> hi = std::min(k, aLen);
+	while(true)
+	{
+		auto i = lo + (hi - lo) / 2;
+		auto j = k - i;
+		if(i > 0 && j < bLen && comp(b[j], a[i - 1])) { hi = i - 1; } //took too many from a
+		else if(j > 0 && i < aLen && !comp(b[j - 1], a[i])) { lo = i + 1; } //took too few
+		else { return i; }
+	}
+}
+
+}
+
+//calls body(i) for every i in [begin, end) using the pool and the calling
+//thread. grain is the smallest chunk a thread takes at once, 0 picks one from
+//the range size. the first exception thrown by body is rethrown here once the
+//other chunks have stopped
+template <std::integral Index, typename Body>
+	requires std::invocable<Body&, Index>
+void parallelFor(ThreadPool& pool, Index begin, Index end, Body&& body,
+	Schedule schedule = Schedule::Adaptive, Index grain = 0)
+{
+	typedef detail::ForState<Index, std::remove_reference_t<Body>> State;
+
+	if(begin >= end) { return; }
+
+	uint32_t threads = pool.getThreadCount() + 1; //the caller works too
+	Index count = end - begin;
+	if(grain <= 0)
+	{
+		grain = std::max<Index>(1, count / static_cast<Index>(threads * 8));
+	}
+
+	if(threads == 1 || count <= grain)
+	{
+		for(Index i = begin; i < end; i++) { body(i); }
+		return;
+	}
+
+	auto state = std::make_shared<State>(pool, body, begin, end, grain, threads, schedule);
+
+	switch(schedule)
+	{
+	case Schedule::Static:
+	{
+		Index block = count / static_cast<Index>(threads);
+		Index extra = count % static_cast<Index>(threads);
+		Index lo = begin + block + (extra > 0 ? 1 : 0); //the caller keeps the first block
+		for(uint32_t t = 1; t < threads && lo < end; t++)
+		{
+			Index hi = lo + block + (static_cast<Index>(t) < extra ? 1 : 0);
+			state->pending++;
+			detail::PoolAccess::post(pool, [state, lo, hi]{
+				state->run(lo, hi);
+				state->finish();
+			});
+			lo = hi;
+		}
+		state->run(begin, begin + block + (extra > 0 ? 1 : 0));
+		break;
+	}
+	case Schedule::Dynamic:
+	case Schedule::Guided:
+		for(uint32_t t = 1; t < threads; t++)
+		{
+			state->pending++;
+			detail::PoolAccess::post(pool, [state]{
+				state->runShared();
+				state->finish();
+			});
+		}
+		state->runShared();
+		break;
+	case Schedule::Adaptive:
+		detail::runAdaptive(state, begin, end);
+		break;
+	}
+
+	state->join(pool);
+}
+
+//calls body(element) for every element of a random access range, see parallelFor
+template <std::ranges::random_access_range Range, typename Body>
+	requires std::ranges::sized_range<Range>
+		&& std::invocable<Body&, std::ranges::range_reference_t<Range>>
+void parallelForEach(ThreadPool& pool, Range&& range, Body&& body,
+	Schedule schedule = Schedule::Adaptive, std::ranges::range_difference_t<Range> grain = 0)
+{
+	typedef std::ranges::range_difference_t<Range> Index;
+
+	auto first = std::ranges::begin(range);
+	parallelFor(pool, Index(0), static_cast<Index>(std::ranges::size(range)),
+		[&body, first](Index i){ body(first[i]); }, schedule, grain);
+}
+
+//like std::transform_reduce, folds transform(x) for every x in [first, last)
+//into init with reduce. with Reduction::Fast reduce has to be associative and
+//commutative, the grouping depends on which thread claimed which chunk. with
+//Reduction::Deterministic it only has to be associative: the range is cut
+//into blocks of grain elements (4096 if 0) regardless of the pool size and
+//the block results are combined in a fixed pairwise tree, so floating point
+//results are the same on every run and every pool
+template <std::random_access_iterator It, typename T, typename Reduce, typename Transform>
+	requires std::invocable<Transform&, std::iter_reference_t<It>>
+T parallelTransformReduce(ThreadPool& pool, It first, It last, T init, Reduce reduce,
+	Transform transform, Reduction mode = Reduction::Fast, std::iter_difference_t<It> grain = 0)
+{
+	typedef std::iter_difference_t<It> Index;
+	typedef detail::ReduceState<T, It, Reduce, Transform> State;
+
+	Index count = last - first;
+	if(count <= 0) { return init; }
+
+	if(mode == Reduction::Deterministic)
+	{
+		Index blockSize = grain > 0 ? grain : 4096;
+		Index blocks = (count + blockSize - 1) / blockSize;
+		std::vector<std::optional<T>> partials(blocks);
+
+		parallelFor(pool, Index(0), blocks, [&](Index b){
+			detail::fold(partials[b], first, b * blockSize, std::min(count, (b + 1) * blockSize),
+				reduce, transform);
+		}, Schedule::Dynamic, Index(1));
+
+		for(Index stride = 1; stride < blocks; stride *= 2)
+		{
+			for(Index i = 0; i + stride < blocks; i += 2 * stride)
+			{
+				partials[i].emplace(reduce(std::move(*partials[i]), std::move(*partials[i + stride])));
+			}
+		}
+		return reduce(std::move(init), std::move(*partials[0]));
+	}
+
+	uint32_t threads = pool.getThreadCount() + 1; //the caller works too
+	if(grain <= 0)
+	{
+		grain = std::max<Index>(1, count / static_cast<Index>(threads * 8));
+	}
+	if(threads == 1 || count <= grain) { threads = 1; }
+
+	auto state = std::make_shared<State>(first, reduce, transform, count, grain, threads);
+	for(uint32_t slot = 1; slot < threads; slot++)
+	{
+		state->pending++;
+		detail::PoolAccess::post(pool, [state, slot]{
+			state->runSlot(slot);
+			state->finish();
+		});
+	}
+	state->runSlot(0);
+	state->join(pool);
+
+	for(uint32_t slot = 0; slot < threads; slot++)
+	{
+		if(state->partials[slot].value)
+		{
+			init = reduce(std::move(init), std::move(*state->partials[slot].value));
+		}
+	}
+	return init;
+}
+
+//like std::reduce, see parallelTransformReduce
+template <std::random_access_iterator It, typename T, typename Reduce = std::plus<>>
+T parallelReduce(ThreadPool& pool, It first, It last, T init, Reduce reduce = {},
+	Reduction mode = Reduction::Fast, std::iter_difference_t<It> grain = 0)
+{
+	return parallelTransformReduce(pool, first, last, std::move(init), reduce,
+		std::identity(), mode, grain);
+}
+
+//like std::inclusive_scan, writes op(first[0], ..., first[i]) to out[i] and
+//returns the end of the output. op has to be associative
+template <std::random_access_iterator InIt, std::random_access_iterator OutIt, typename Op = std::plus<>>
+OutIt parallelInclusiveScan(ThreadPool& pool, InIt first, InIt last, OutIt out, Op op = {})
+{
+	return detail::scan<std::iter_value_t<InIt>>(pool, first, last, out, op, std::nullopt, true);
+}
+
+//same as above with init folded in front of the first element
+template <std::random_access_iterator InIt, std::random_access_iterator OutIt, typename Op, typename T>
+OutIt parallelInclusiveScan(ThreadPool& pool, InIt first, InIt last, OutIt out, Op op, T init)
+{
+	return detail::scan<T>(pool, first, last, out, op, std::optional<T>(std::move(init)), true);
+}
+
+//like std::exclusive_scan, writes op(init, first[0], ..., first[i - 1]) to
+//out[i]. out may be the same as first
+template <std::random_access_iterator InIt, std::random_access_iterator OutIt, typename T, typename Op = std::plus<>>
+OutIt parallelExclusiveScan(ThreadPool& pool, InIt first, InIt last, OutIt out, T init, Op op = {})
+{
+	return detail::scan<T>(pool, first, last, out, op, std::optional<T>(std::move(init)), false);
+}
+
+//sorts [first, last) with a parallel merge sort: the range is cut into
+//leaves that are std::sort-ed in parallel, then merged in rounds with every
+//merge split into pieces along its merge path so the last rounds stay parallel
+//too. ranges below cutoff elements, pools without threads and element types
+//that can't be default constructed for the merge buffer just use std::sort
+template <std::random_access_iterator It, typename Comp = std::less<>>
+void parallelSort(ThreadPool& pool, It first, It last, Comp comp = {},
+	std::iter_difference_t<It> cutoff = 16384)
+{
+	typedef std::iter_difference_t<It> Index;
+	typedef std::iter_value_t<It> T;
+
+	Index count = last - first;
+	uint32_t threads = pool.getThreadCount() + 1;
+	if constexpr(std::default_initializable<T>)
+	{
+		if(count > cutoff && threads > 1)
+		{
+			//a power of two number of leaves, each at least cutoff long
+			Index leaves = 1;
+			while(leaves < static_cast<Index>(threads * 2) && count / (leaves * 2) >= cutoff) { leaves *= 2; }
+
+			auto bound = [count, leaves](Index leaf) { return count * leaf / leaves; };
+			parallelFor(pool, Index(0), leaves, [&](Index leaf){
+				std::sort(first + bound(leaf), first + bound(leaf + 1), comp);
+			}, Schedule::Dynamic, Index(1));
+
+			std::vector<T> buffer(count);
+			bool inBuffer = false;
+			for(Index width = 1; width < leaves; width *= 2)
+			{
+				Index pairs = leaves / (width * 2);
+				Index pieces = std::max<Index>(1, static_cast<Index>(threads * 4) / pairs);
+				auto range = [&](Index pair, Index& lo, Index& mid, Index& hi) {
+					lo = bound(pair * width * 2);
+					mid = bound(pair * width * 2 + width);
+					hi = bound((pair + 1) * width * 2);
+				};
+
+				//every split is found before anything is moved, the binary search
+				//of one piece reads elements another piece is about to move from
+				std::vector<Index> splits(pairs * (pieces + 1));
+				parallelFor(pool, Index(0), pairs * (pieces + 1), [&](Index task){
+					Index pair = task / (pieces + 1);
+					Index lo, mid, hi;
+					range(pair, lo, mid, hi);
+					Index k = (hi - lo) * (task % (pieces + 1)) / pieces;
+					splits[task] = inBuffer
+						? detail::coRank(k, buffer.begin() + lo, mid - lo, buffer.begin() + mid, hi - mid, comp)
+						: detail::coRank(k, first + lo, mid - lo, first + mid, hi - mid, comp);
+				}, Schedule::Dynamic, Index(1));
+
+				parallelFor(pool, Index(0), pairs * pieces, [&](Index task){
+					Index pair = task / pieces;
+					Index piece = task % pieces;
+					Index lo, mid, hi;
+					range(pair, lo, mid, hi);
+					Index k0 = (hi - lo) * piece / pieces;
+					Index k1 = (hi - lo) * (piece + 1) / pieces;
+					Index i0 = splits[pair * (pieces + 1) + piece];
+					Index i1 = splits[pair * (pieces + 1) + piece + 1];
+
+					auto merge = [&](auto src, auto dst) {
+						std::merge(std::make_move_iterator(src + lo + i0), std::make_move_iterator(src + lo + i1),
+							std::make_move_iterator(src + mid + (k0 - i0)), std::make_move_iterator(src + mid + (k1 - i1)),
+							dst + lo + k0, comp);
+					};
+					if(inBuffer) { merge(buffer.begin(), first); }
+					else { merge(first, buffer.begin()); }
+				}, Schedule::Dynamic, Index(1));
+				inBuffer = !inBuffer;
+			}
+
+			if(inBuffer)
+			{
+				parallelFor(pool, Index(0), count, [&](Index i){ first[i] = std::move(buffer[i]); },
+					Schedule::Static);
+			}
+			return;
+		}
+	}
+	std::sort(first, last, comp);
+}
+
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace avenir
+{
+
+//the machine's cpus grouped by NUMA node. read from sysfs on linux, anywhere
+//else (or if sysfs isn't readable) it is a single node holding every cpu
+struct Topology
+{
+	std::vector<std::vector<uint32_t>> nodes; //the cpus of every node
+
+	//read once, the first time it's asked for
+	static const Topology& get();
+	//0 for a cpu the topology doesn't know about
+	uint32_t nodeOf(uint32_t cpu) const;
+};
+
+//the cpus one thread may run on and the node they belong to. an empty set
+//leaves the thread wherever the os puts it
+struct CpuSet
+{
+	std::vector<uint32_t> cpus;
+	uint32_t node = 0;
+};
+
+//where a ThreadPool puts the threads it adds: the n-th thread gets
+//sets[n % sets.size()]. an empty placement doesn't pin anything
+struct Placement
+{
+	std::vector<CpuSet> sets;
+
+	//one thread per cpu, filling a node before moving on to the next
+	static Placement perCore();
+	//threads may move between the cpus of a node but never leave it, handed
+	//out to the nodes in turn
+	static Placement perNode();
+};
+
+//restricts the calling thread to cpus, false if the os refused or
+//pinning isn't supported here
+bool pinThisThread(const std::vector<uint32_t>& cpus);
+
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
+
+namespace avenir
+{
+
+//tells the cpu we are busy waiting, frees the core for a hyperthread sibling
+inline void cpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+	_mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+	asm volatile("yield");
+#endif
+}
+
+//the spin phase a thread goes through before it parks. every round backs off
+//further: the first ones are a growing number of pause instructions, the
+//rest yield the thread. the number of rounds adapts to the waiter's recent
+//waits, waits that finish near the end of the budget double it and waits
+//that have to park anyway halve it, so a thread whose waits are long soon
+//stops burning cpu while one with short waits keeps skipping the sleep. the
+//budget moves between MinRounds and getMaxRounds()
+class AdaptiveSpinner
+{
+public:
+	static constexpr uint32_t PauseRounds = 10;
+	static constexpr uint32_t MinRounds = 4;
+
+	//true if done() became true while spinning, false if the caller should park
+	template <typename Done>
+	bool spin(Done&& done)
+	{
+		//the cap clamps the budget itself rather than only the rounds spun, so
+		//a budget can always grow as far as the cap. with spinning off it
+		//stays at MinRounds
+		uint32_t maxRounds = s_maxRounds.load(std::memory_order_relaxed);
+		uint32_t maxBudget = std::max(maxRounds, MinRounds);
+		m_budget = std::min(m_budget, maxBudget);
+		uint32_t limit = std::min(m_budget, maxRounds);
+		for(uint32_t round = 0; round < limit; round++)
+		{
+			if(done())
+			{
+				if(round * 2 > m_budget) { m_budget = std::min(m_budget * 2, maxBudget); }
+				return true;
+			}
+
+			if(round < PauseRounds)
+			{
+				for(uint32_t i = 0; i < (1u << round); i++) { cpuRelax(); }
+			}
+			else
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		if(done()) { return true; }
+		m_budget = std::max(m_budget / 2, MinRounds);
+		return false;
+	}
+
+	//the spinner of the calling thread, for waits that have nowhere else to keep one
+	static AdaptiveSpinner& forThisThread();
+
+	//upper bound on the budget of every spinner, 0 turns spinning off
+	static void setMaxRounds(uint32_t rounds) { s_maxRounds.store(rounds, std::memory_order_relaxed); }
+	static uint32_t getMaxRounds() { return s_maxRounds.load(std::memory_order_relaxed); }
+private:
+	static std::atomic<uint32_t> s_maxRounds;
+
+	uint32_t m_budget = PauseRounds + 16;
+};
+
+}
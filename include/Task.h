@@ -0,0 +1,118 @@
+#pragma once
+#include <concepts>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace avenir
+{
+
+//move only, type erased void() callable. a callable that fits in InlineSize
+//bytes and is nothrow movable is stored inside the task itself so queueing it
+//never allocates, anything bigger falls back to a single heap allocation.
+//there is no result or exception channel, capture a Promise in it if you
+//need one
+class Task
+{
+public:
+	static constexpr std::size_t InlineSize = 48;
+
+	Task() = default;
+
+	template <typename Func>
+		requires (!std::same_as<std::decay_t<Func>, Task>) && std::invocable<std::decay_t<Func>&>
+	Task(Func&& f)
+	{
+		typedef std::decay_t<Func> F;
+		if constexpr(fitsInline<F>())
+		{
+			::new (static_cast<void*>(m_storage)) F(std::forward<Func>(f));
+			m_vtable = &s_inlineTable<F>;
+		}
+		else
+		{
+			::new (static_cast<void*>(m_storage)) F*(new F(std::forward<Func>(f)));
+			m_vtable = &s_heapTable<F>;
+		}
+	}
+
+	Task(const Task& oth) = delete;
+	Task& operator= (const Task& oth) = delete;
+
+	Task(Task&& oth) noexcept : m_vtable(oth.m_vtable)
+	{
+		if(m_vtable != nullptr)
+		{
+			m_vtable->relocate(m_storage, oth.m_storage);
+			oth.m_vtable = nullptr;
+		}
+	}
+
+	Task& operator= (Task&& oth) noexcept
+	{
+		if(this != &oth)
+		{
+			reset();
+			m_vtable = oth.m_vtable;
+			if(m_vtable != nullptr)
+			{
+				m_vtable->relocate(m_storage, oth.m_storage);
+				oth.m_vtable = nullptr;
+			}
+		}
+		return *this;
+	}
+
+	~Task() { reset(); }
+
+	void operator()() { m_vtable->invoke(m_storage); }
+
+	explicit operator bool() const { return m_vtable != nullptr; }
+
+	void reset()
+	{
+		if(m_vtable != nullptr)
+		{
+			m_vtable->destroy(m_storage);
+			m_vtable = nullptr;
+		}
+	}
+private:
+	struct VTable
+	{
+		void (*invoke)(void* storage);
+		//move construct into dst and destroy what is left in src
+		void (*relocate)(void* dst, void* src) noexcept;
+		void (*destroy)(void* storage) noexcept;
+	};
+
+	template <typename F>
+	static constexpr bool fitsInline()
+	{
+		return sizeof(F) <= InlineSize && alignof(F) <= alignof(std::max_align_t)
+			&& std::is_nothrow_move_constructible_v<F>;
+	}
+
+	template <typename F>
+	static constexpr VTable s_inlineTable = {
+		[](void* storage) { (*static_cast<F*>(storage))(); },
+		[](void* dst, void* src) noexcept {
+			::new (dst) F(std::move(*static_cast<F*>(src)));
+			static_cast<F*>(src)->~F();
+		},
+		[](void* storage) noexcept { static_cast<F*>(storage)->~F(); }
+	};
+
+	template <typename F>
+	static constexpr VTable s_heapTable = {
+		[](void* storage) { (**static_cast<F**>(storage))(); },
+		[](void* dst, void* src) noexcept { ::new (dst) F*(*static_cast<F**>(src)); },
+		[](void* storage) noexcept { delete *static_cast<F**>(storage); }
+	};
+
+	alignas(std::max_align_t) unsigned char m_storage[InlineSize];
+	const VTable* m_vtable = nullptr;
+};
+
+}
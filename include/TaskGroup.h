@@ -0,0 +1,189 @@
+#pragma once
+#include <atomic>
+#include <concepts>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "ThreadPool.h"
+
+namespace avenir
+{
+
+namespace detail
+{
+
+//bookkeeping shared between a thread waiting on a batch of jobs and the jobs
+//themselves. it lives on the heap so a job can still touch it after the
+//waiter has seen the count hit zero and returned
+struct JoinState
+{
+	std::atomic<uint32_t> pending = 0;
+	std::atomic<bool> failed = false;
+	std::exception_ptr error;
+
+	//call from inside a catch block, only the first exception is kept
+	void fail()
+	{
+		if(!failed.exchange(true)) { error = std::current_exception(); }
+	}
+
+	void finish()
+	{
+		if(pending.fetch_sub(1, std::memory_order_acq_rel) == 1) { pending.notify_all(); }
+	}
+
+	//run other pool jobs until everything we pushed is done, only sleep when
+	//there is nothing to help with. rethrows the first exception a job hit
+	void join(ThreadPool& pool)
+	{
+		uint32_t left;
+		while((left = pending.load(std::memory_order_acquire)) != 0)
+		{
+			if(!help(pool)) { pending.wait(left, std::memory_order_acquire); }
+		}
+		if(error) { std::rethrow_exception(error); }
+	}
+
+	//runs one queued pool job on this thread. every job run this way sits on
+	//top of the join that picked it up, s_helpDepth counts how many do
+	static bool help(ThreadPool& pool)
+	{
+		s_helpDepth++;
+		bool ran = pool.runPendingJob();
+		s_helpDepth--;
+		return ran;
+	}
+
+	static inline thread_local uint32_t s_helpDepth = 0;
+};
+
+//a TaskGroup's JoinState, plus a stack of its jobs that no thread has picked
+//up yet. the pool gets a job per spawn too, whichever of it and the waiting
+//thread claims one first runs it
+struct GroupState : JoinState
+{
+	struct Spawned
+	{
+		std::atomic<bool> claimed = false;
+		Task job;
+	};
+
+	//a waiter past this many helped jobs only runs its own group's jobs, any
+	//foreign job could be a whole outer subtree that spawns and waits again
+	static constexpr uint32_t MaxHelpDepth = 8;
+
+	//like JoinState::join, but the group's own jobs go first, newest first as
+	//a serial run would have done them. once every one has been claimed the
+	//rest are running on other threads and helping is optional
+	void join(ThreadPool& pool)
+	{
+		uint32_t left;
+		while((left = pending.load(std::memory_order_acquire)) != 0)
+		{
+			if(runNewest()) { continue; }
+			if(s_helpDepth < MaxHelpDepth && help(pool)) { continue; }
+			pending.wait(left, std::memory_order_acquire);
+		}
+		if(error) { std::rethrow_exception(error); }
+	}
+
+	static void run(Spawned& spawned)
+	{
+		if(spawned.claimed.exchange(true, std::memory_order_acq_rel)) { return; }
+		spawned.job();
+		spawned.job.reset();
+	}
+
+	bool runNewest()
+	{
+		std::shared_ptr<Spawned> spawned;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			while(!unstarted.empty() && !spawned)
+			{
+				if(!unstarted.back()->claimed.load(std::memory_order_relaxed)) { spawned = std::move(unstarted.back()); }
+				unstarted.pop_back();
+			}
+		}
+		if(!spawned) { return false; }
+		run(*spawned);
+		return true;
+	}
+
+	std::mutex mutex;
+	std::vector<std::shared_ptr<Spawned>> unstarted;
+};
+
+}
+
+//fork join on top of a ThreadPool. spawn pushes jobs, wait runs the group's
+//jobs that haven't started yet on the waiting thread, then other queued pool
+//jobs until every spawned job is done. waiting from inside a pool job never
+//parks a worker that could be making progress, recursive divide and conquer
+//can't deadlock a small pool and the waiter's stack only grows with the
+//recursion depth
+class TaskGroup
+{
+public:
+	TaskGroup(ThreadPool& pool) : m_pool(pool), m_state(std::make_shared<detail::GroupState>()) {}
+	TaskGroup(const TaskGroup& other) = delete; //no copy constructor
+	TaskGroup& operator= (const TaskGroup& other) = delete; //no copy assignment
+	TaskGroup(TaskGroup&& other) = delete; //no move constructor
+	TaskGroup& operator= (TaskGroup&& other) = delete; //no move assignment
+
+	//waits for anything still running, exceptions are dropped here so call
+	//wait yourself if you care about them
+	~TaskGroup()
+	{
+		try { wait(); }
+		catch(...) {}
+	}
+
+	//once a spawned job has thrown, jobs that haven't started yet are skipped
+	template <std::invocable Func>
+	void spawn(Func&& f)
+	{
+		auto spawned = std::make_shared<detail::GroupState::Spawned>();
+		//the job doesn't hold the state, the state holds the job
+		detail::GroupState* state = m_state.get();
+		//f is destroyed before finish, once wait returns nothing of it is left
+		spawned->job = Task([state, f = std::optional<std::decay_t<Func>>(std::forward<Func>(f))]() mutable {
+			if(!state->failed.load(std::memory_order_relaxed))
+			{
+				try { (*f)(); }
+				catch(...) { state->fail(); }
+			}
+			f.reset();
+			state->finish();
+		});
+
+		m_state->pending++;
+		{
+			std::lock_guard<std::mutex> lock(m_state->mutex);
+			m_state->unstarted.push_back(spawned);
+		}
+		detail::PoolAccess::post(m_pool, [state = m_state, spawned = std::move(spawned)]{ detail::GroupState::run(*spawned); });
+	}
+
+	//returns once every job spawned so far has finished and rethrows the
+	//first exception one of them threw. the group can be reused afterwards
+	void wait()
+	{
+		std::exception_ptr error;
+		try { m_state->join(m_pool); }
+		catch(...) { error = std::current_exception(); }
+
+		m_state->failed = false;
+		m_state->error = nullptr;
+		if(error) { std::rethrow_exception(error); }
+	}
+private:
+	ThreadPool& m_pool;
+	std::shared_ptr<detail::GroupState> m_state;
+};
+
+}
@@ -1,79 +1,499 @@
 #pragma once
 
 #include <thread>
-#include <condition_variable>
 #include <mutex>
 #include <list>
+#include <vector>
+#include <memory>
+#include <optional>
 #include <functional>
 #include <future>
-#include <stack>
 #include <concepts>
 #include <atomic>
+#include <array>
+#include <chrono>
+#include <ranges>
+#include <stop_token>
+
+#include "WorkStealingDeque.h"
+#include "MPMCQueue.h"
+#include "Task.h"
+#include "Future.h"
+#include "SpinWait.h"
+#include "Placement.h"
+#include "TimerWheel.h"
 
 namespace avenir
 {
+//lower values run first. the pool keeps a shared queue per level, so more
+//levels can be added here as long as PriorityLevels is kept in step
+enum class Priority : uint8_t { High, Normal, Low };
+inline constexpr uint32_t PriorityLevels = 3;
+
+//what a push does when the pool already holds its capacity of queued jobs
+enum class OverflowPolicy : uint8_t
+{
+	Block, //wait until a thread takes a job off the queue
+	Fail, //throw QueueFullError, nothing is queued
+	RunInline, //run the job on the pushing thread
+	DropOldest //destroy the oldest job of the lowest priority, its future gets broken_promise
+};
+
+class QueueFullError : public std::exception
+{
+public:
+	const char* what() const noexcept override { return "avenir: job queue is full"; }
+};
+
+namespace detail
+{
+struct PoolAccess;
+}
+
 class ThreadPool
 {
 public:
 //constructors and assignment operators
 	ThreadPool(uint32_t numThreads);
 	//construct by moving tasks from a list
+	ThreadPool(uint32_t numThreads, std::list<Task>& queue);
 	ThreadPool(uint32_t numThreads, std::list<std::packaged_task<void()>>& queue);
+	//pin the threads as placement says, see setPlacement
+	ThreadPool(uint32_t numThreads, Placement placement);
 	ThreadPool(const ThreadPool& other) = delete; //no copy constructor
 	ThreadPool& operator= (const ThreadPool& other) = delete; //no copy assignment
 	ThreadPool(ThreadPool&& other) = delete; //no move constructor
 	ThreadPool& operator= (ThreadPool&& other) = delete; //no move assignment
 	~ThreadPool();
 //other functions
-	template <std::invocable<void> Func>
+	//jobs pushed from one of this pool's own threads go onto that thread's
+	//local deque, everything else goes onto the lock free shared queue
+	template <std::invocable Func>
 	auto pushJob(const Func& f)
 	{
 		typedef decltype(f()) RetType;
 		
-		std::packaged_task<RetType()> task(std::move(f));
-		std::future<RetType> future = task.get_future();
+		Promise<RetType> promise;
+		Future<RetType> future = promise.getFuture();
+		
+		enqueue(makeJob(f, std::move(promise)));
+		
+		return future;
+	}
+	
+	template <typename Func, typename... Args>
+		requires std::invocable<Func, Args...>
+	auto pushJob(const Func& f, Args&&... args) //overload if the user wants to push a job that takes arguments
+	{
+		return pushJob(std::bind(f, args...));
+	}
+	
+	//a job that is dropped if token is stopped before a thread picks it up,
+	//the future then holds a CancelledError. a running job can poll the
+	//token by taking it as its argument
+	template <typename Func>
+		requires std::invocable<Func&> || std::invocable<Func&, std::stop_token&>
+	auto pushJob(std::stop_token token, const Func& f)
+	{
+		typedef decltype(invokeJob(std::declval<Func&>(), token)) RetType;
+		
+		Promise<RetType> promise;
+		Future<RetType> future = promise.getFuture();
+		
+		enqueue(makeJob(f, std::move(promise), std::move(token)));
+		
+		return future;
+	}
+	
+	//a job that is picked before any queued job of a lower priority. High and
+	//Low jobs always go through the shared queues, Normal is the same as the
+	//overloads without a priority
+	template <std::invocable Func>
+	auto pushJob(Priority priority, const Func& f)
+	{
+		typedef decltype(f()) RetType;
+		
+		Promise<RetType> promise;
+		Future<RetType> future = promise.getFuture();
 		
-		std::unique_lock<std::mutex> lock(m_queueMutex);
+		enqueue(makeJob(f, std::move(promise)), priority);
 		
-		m_jobQueue.emplace_back(std::move(task));
+		return future;
+	}
+	
+	//queue f once delay has passed, no thread is taken until then. a single
+	//timer thread per pool, started on first use, keeps the time at about
+	//1ms resolution. a job still waiting when the pool is destroyed is
+	//dropped and its future gets broken_promise
+	template <typename Rep, typename Period, std::invocable Func>
+	auto pushJobAfter(std::chrono::duration<Rep, Period> delay, const Func& f)
+	{
+		return scheduleJob(std::chrono::steady_clock::now() + delay, f);
+	}
+	
+	template <typename Clock, typename Duration, std::invocable Func>
+	auto pushJobAt(std::chrono::time_point<Clock, Duration> when, const Func& f)
+	{
+		return scheduleJob(toSteady(when), f);
+	}
+	
+	//cancellable versions, stopping token takes the job off the timer at once
+	//and its future gets a CancelledError
+	template <typename Rep, typename Period, typename Func>
+		requires std::invocable<Func&> || std::invocable<Func&, std::stop_token&>
+	auto pushJobAfter(std::stop_token token, std::chrono::duration<Rep, Period> delay, const Func& f)
+	{
+		return scheduleJob(std::chrono::steady_clock::now() + delay, f, std::move(token));
+	}
+	
+	template <typename Clock, typename Duration, typename Func>
+		requires std::invocable<Func&> || std::invocable<Func&, std::stop_token&>
+	auto pushJobAt(std::stop_token token, std::chrono::time_point<Clock, Duration> when, const Func& f)
+	{
+		return scheduleJob(toSteady(when), f, std::move(token));
+	}
+	
+	//never waits and never runs f here: if the pool is at capacity nothing is
+	//queued and the optional comes back empty, whatever the overflow policy
+	template <std::invocable Func>
+	auto tryPushJob(const Func& f, Priority priority = Priority::Normal)
+	{
+		typedef decltype(f()) RetType;
 		
-		lock.unlock();
+		Promise<RetType> promise;
+		std::optional<Future<RetType>> future(promise.getFuture());
 		
-		m_cv.notify_one();
+		if(!tryReserve(1))
+		{
+			future.reset();
+			return future;
+		}
+		place(makeJob(f, std::move(promise)), priority);
 		
 		return future;
 	}
 	
+	//push every callable in a range in one go, the shared queue is claimed
+	//once and at most one sleeping thread per job is woken. the futures come
+	//back in the same order as the range
+	template <std::ranges::input_range Range>
+		requires std::invocable<std::ranges::range_reference_t<Range>>
+	auto pushJobs(Range&& funcs)
+	{
+		typedef std::invoke_result_t<std::ranges::range_reference_t<Range>> RetType;
+		
+		std::vector<Task> tasks;
+		std::vector<Future<RetType>> futures;
+		if constexpr(std::ranges::sized_range<Range>)
+		{
+			tasks.reserve(std::ranges::size(funcs));
+			futures.reserve(std::ranges::size(funcs));
+		}
+		
+		for(auto&& f : funcs)
+		{
+			Promise<RetType> promise;
+			futures.push_back(promise.getFuture());
+			tasks.push_back(makeJob(std::forward<decltype(f)>(f), std::move(promise)));
+		}
+		
+		enqueueBulk(tasks);
+		
+		return futures;
+	}
+	
+	//overload taking a generator, gen(i) is called for every i in [0, count)
+	//and returns the job to push
+	template <typename Gen>
+		requires std::invocable<Gen&, size_t> && std::invocable<std::invoke_result_t<Gen&, size_t>>
+	auto pushJobs(size_t count, Gen&& gen)
+	{
+		return pushJobs(std::views::iota(size_t(0), count) | std::views::transform(std::ref(gen)));
+	}
+	
+	//queue a job without a future, nothing is allocated if f fits inline in a
+	//Task. an exception escaping f is swallowed, use pushJob if you need it
+	template <std::invocable Func>
+	void post(Func&& f)
+	{
+		enqueue(Task(std::forward<Func>(f)));
+	}
+	
 	template <typename Func, typename... Args>
 		requires std::invocable<Func, Args...>
-	auto pushJob(const Func& f, Args&&... args) //overload if the user wants to push a job that takes arguments
+	void post(const Func& f, Args&&... args)
 	{
-		return pushJob(std::bind(f, args...));
+		post(std::bind(f, args...));
+	}
+	
+	template <std::invocable Func>
+	void post(Priority priority, Func&& f)
+	{
+		enqueue(Task(std::forward<Func>(f)), priority);
 	}
 	
 	void addThreads(uint32_t numThreads);
 	
+	//threads added from now on are pinned by placement, the i-th thread of
+	//the pool getting sets[i % sets.size()]. threads already running stay
+	//where they are. a worker out of jobs steals from the workers of its
+	//own node before it tries the rest
+	void setPlacement(Placement placement);
+	
 	//removes threads from the threadpool, they will be stopped and
 	//this function will block untill all threads removed have joined
 	void removeThreads(uint32_t numThreads);
 	
+	//takes threads out of the pool without waiting for them. only those
+	//threads are woken, one in the middle of a job finishes it first and
+	//hands back anything left on its deque. the future is ready once every
+	//one of them has stopped running pool code, they are joined later
+	Future<void> retireThreads(uint32_t numThreads);
+	
+	//elastic mode, off while maxThreads is 0 which is the default. a push
+	//that finds no idle thread and more than growDepth jobs queued starts
+	//another thread, up to maxThreads. an empty pool always starts one. a
+	//thread that has been idle for keepAlive retires itself as long as more
+	//than minThreads are left, without anyone waiting for it to exit. the
+	//pool is topped up to minThreads straight away
+	void setElastic(uint32_t minThreads, uint32_t maxThreads,
+		std::chrono::milliseconds keepAlive = std::chrono::seconds(30), uint32_t growDepth = 1);
+	
 	//move all unstarted tasks into a new queue and return it
 	std::list<std::packaged_task<void()>> moveTasks();
+	//same as moveTasks, but hands the tasks back as they are queued without
+	//wrapping each one into a packaged_task
+	std::list<Task> moveTaskList();
 
-	//move tasks from a list into the queue
+	//move tasks from a list into the queue and wake threads to run them,
+	//they are let in even if that goes over the capacity
+	void pushTasks(std::list<Task>& tasks);
 	void pushTasks(std::list<std::packaged_task<void()>>& tasks);
 
+	//run one queued job on the calling thread if there is one. lets a thread
+	//that is waiting on pool work help out instead of blocking
+	bool runPendingJob();
+	
 	//wait until the queue is empty, other threads can still push taks while
 	//the waiting thread is blocked
 	void waitTilEmpty();
 	
+	//at most capacity jobs can be queued at once, 0 means no limit which is
+	//the default. a push that finds the pool full follows policy, except a
+	//blocking push from one of the pool's own threads which runs the job
+	//inline instead of waiting on itself. the jobs of the parallel algorithms,
+	//TaskGroup and timed pushes that came due count towards the queue but are
+	//always let in
+	void setCapacity(uint32_t capacity, OverflowPolicy policy = OverflowPolicy::Block);
+	uint32_t getCapacity() const;
+	OverflowPolicy getOverflowPolicy() const;
+	
+	//the most jobs that have been queued at once since construction or the
+	//last reset, useful for picking a capacity
+	uint32_t getHighWaterMark() const;
+	void resetHighWaterMark();
+	
 	uint32_t getThreadCount() const;
 	uint32_t jobsRemaining() const;
 private:
-	std::stack<std::jthread> m_pool;
-	std::list<std::packaged_task<void()>> m_jobQueue;
-	std::condition_variable_any m_cv;
+	//shared by the threads one retireThreads call stops, the last one out
+	//fulfils the promise
+	struct Retirement
+	{
+		std::atomic<uint32_t> remaining;
+		Promise<void> done;
+	};
+	
+	struct Worker
+	{
+		ThreadPool* owner;
+		WorkStealingDeque<Task> deque;
+		std::jthread thread;
+		CpuSet placement;
+		//this worker's copy of the pool, refreshed when m_poolVersion moves on.
+		//the raw lists split it by node and don't include this worker
+		std::shared_ptr<const std::vector<std::shared_ptr<Worker>>> victims;
+		std::vector<Worker*> nearVictims;
+		std::vector<Worker*> farVictims;
+		uint32_t victimsVersion = 0;
+		//how long to look for new jobs before going to sleep
+		AdaptiveSpinner spinner;
+		//set as the thread's last act, joining it won't block after that
+		std::atomic<bool> finished = false;
+		//what an idle worker parks on, whoever takes it off m_sleepers sets it
+		std::atomic<uint32_t> wakeSlot = 0;
+		std::shared_ptr<Retirement> retirement; //set before the stop request
+		//set once a retired worker has handed back its deque, until then it
+		//stays where thieves can see it. guarded by m_poolMutex
+		bool drained = false;
+	};
+	typedef std::vector<std::shared_ptr<Worker>> WorkerList;
+	
+	//the shared queues of one priority level
+	struct Level
+	{
+		MPMCQueue<Task> inject; //jobs pushed from outside the pool
+		//spill over for when inject is full, guarded by m_queueMutex. jobs
+		//keep going here until it is empty so none can jump ahead of it
+		std::list<Task> overflow;
+		std::atomic<uint32_t> overflowCount = 0;
+		//jobs of a higher level picked while this one had jobs waiting
+		std::atomic<uint32_t> passedOver = 0;
+	};
+	
+	//a level passed over this many times gets the next pick, so a steady
+	//stream of higher priority jobs can't starve it
+	static constexpr uint32_t AgingLimit = 16;
+	
+	//the worker running on the calling thread, if any
+	static thread_local Worker* s_currentWorker;
+	
+	//calls f with the token if it takes one
+	template <typename Func, typename... Token>
+	static decltype(auto) invokeJob(Func& f, Token&... token)
+	{
+		if constexpr(sizeof...(Token) != 0 && std::invocable<Func&, Token&...>) { return f(token...); }
+		else { return f(); }
+	}
+	
+	//a job that runs f and hands its result or exception to promise. token
+	//is empty or a single std::stop_token that is checked before f runs
+	template <typename Func, typename RetType, typename... Token>
+	static Task makeJob(Func&& f, Promise<RetType>&& promise, Token... token)
+	{
+		return Task([f = std::forward<Func>(f), promise = std::move(promise), ...token = std::move(token)]() mutable {
+			if((token.stop_requested() || ...))
+			{
+				promise.setException(detail::cancelledError());
+				return;
+			}
+			try
+			{
+				if constexpr(std::is_void_v<RetType>)
+				{
+					invokeJob(f, token...);
+					promise.setValue();
+				}
+				else
+				{
+					promise.setValue(invokeJob(f, token...));
+				}
+			}
+			catch(...)
+			{
+				promise.setException(std::current_exception());
+			}
+		});
+	}
+	
+	template <typename Func, typename... Token>
+	auto scheduleJob(std::chrono::steady_clock::time_point when, const Func& f, Token... token)
+	{
+		typedef decltype(invokeJob(std::declval<Func&>(), token...)) RetType;
+		
+		Promise<RetType> promise;
+		Future<RetType> future = promise.getFuture();
+		
+		timers().schedule(when, makeJob(f, std::move(promise), token...), token...);
+		
+		return future;
+	}
+	
+	template <typename Clock, typename Duration>
+	static std::chrono::steady_clock::time_point toSteady(std::chrono::time_point<Clock, Duration> when)
+	{
+		typedef std::chrono::steady_clock::duration Steady;
+		if constexpr(std::is_same_v<Clock, std::chrono::steady_clock>) { return std::chrono::time_point_cast<Steady>(when); }
+		else { return std::chrono::steady_clock::now() + std::chrono::duration_cast<Steady>(when - Clock::now()); }
+	}
+	
+	TimerWheel& timers();
+	//queues a job whatever the capacity, for the timer thread and the
+	//library's own fork join jobs. those are already owed to someone who is
+	//waiting on them, refusing or dropping one would strand its waiter
+	void postUncapped(Task&& job);
+	friend struct detail::PoolAccess;
+	
+	//enqueue counts the job in, or applies the overflow policy if there is no
+	//room. place queues a job that has already been counted
+	void enqueue(Task&& job, Priority priority = Priority::Normal);
+	void place(Task&& job, Priority priority);
+	bool tryReserve(uint32_t count);
+	//false if the job was run instead of getting a slot
+	bool makeRoom(Task& job);
+	void waitForRoom();
+	std::optional<Task> takeOldest();
+	void jobTaken();
+	void wakeProducers();
+	void pushShared(Task&& job, Priority priority = Priority::Normal);
+	void enqueueBulk(std::vector<Task>& jobs);
+	//worker is null when the caller isn't one of our threads
+	std::optional<Task> findJob(Worker* worker);
+	std::optional<Task> popLevel(uint32_t level, Worker* worker);
+	void passOver(uint32_t level, Worker* worker);
+	void runJob(Task& job);
+	void workerLoop(Worker& worker, std::stop_token stoken);
+	void refreshVictims(Worker& worker);
+	//these two expect m_poolMutex to be held
+	void startWorkers(uint32_t numThreads);
+	void publishWorkers();
+	//starts a thread if elastic mode calls for one
+	void grow();
+	//takes worker out of the pool if elastic mode lets it go
+	bool retire(Worker& worker);
+	//joins retired threads that have finished, or all of them
+	void reapRetired(bool all = false);
+	//false if keepAlive ran out before anyone woke the worker
+	bool park(Worker& worker, const std::stop_token& stoken);
+	//these two expect m_queueMutex to be held
+	void unpark(size_t sleeper);
+	void wakeSleeper(Worker& worker);
+	void wake(uint32_t count);
+	std::shared_ptr<const WorkerList> workers() const;
+	
+	WorkerList m_pool; //guarded by m_poolMutex
+	std::mutex m_poolMutex;
+	Placement m_placement; //guarded by m_poolMutex
+	//threads that retired and still have to be joined, guarded by m_poolMutex
+	WorkerList m_retired;
+	std::atomic<uint32_t> m_threadCount = 0; //m_pool.size() without the lock
+	//immutable copy of m_pool and the retired workers that still have a
+	//deque to hand back, for thieves. swapped under m_workersMutex
+	std::shared_ptr<const WorkerList> m_workers = std::make_shared<const WorkerList>();
+	mutable std::mutex m_workersMutex;
+	std::atomic<uint32_t> m_poolVersion = 0;
+	std::array<Level, PriorityLevels> m_levels; //pushTasks splices to the Normal overflow
 	std::mutex m_queueMutex;
+	//parked workers, the most recent last, guarded by m_queueMutex
+	std::vector<Worker*> m_sleepers;
 	std::atomic_flag m_waitFlag;
+	std::atomic<uint32_t> m_jobCount = 0; //jobs queued anywhere, local or shared
+	std::atomic<uint32_t> m_idleCount = 0; //m_sleepers.size() without the lock
+	std::atomic<uint32_t> m_capacity = 0;
+	std::atomic<OverflowPolicy> m_overflowPolicy = OverflowPolicy::Block;
+	std::atomic<uint32_t> m_highWaterMark = 0;
+	//producers waiting for room park on m_roomSignal, which moves on
+	//whenever a slot may have been freed
+	std::atomic<uint32_t> m_blockedProducers = 0;
+	std::atomic<uint32_t> m_roomSignal = 0;
+	std::atomic<uint32_t> m_minThreads = 0;
+	std::atomic<uint32_t> m_maxThreads = 0;
+	std::atomic<std::chrono::milliseconds> m_keepAlive = std::chrono::milliseconds(0);
+	std::atomic<uint32_t> m_growDepth = 0;
+	std::unique_ptr<TimerWheel> m_timers; //started by the first timed push
+	std::once_flag m_timersOnce;
 };
+
+namespace detail
+{
+
+//lets the parallel algorithms and TaskGroup queue their jobs past the
+//capacity and the overflow policy
+struct PoolAccess
+{
+	template <std::invocable Func>
+	static void post(ThreadPool& pool, Func&& f) { pool.postUncapped(Task(std::forward<Func>(f))); }
+};
+
+}
 }
@@ -0,0 +1,92 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+#include "Task.h"
+
+namespace avenir
+{
+
+//hierarchical timing wheel driven by one thread that hands tasks to fire once
+//they are due. there are Levels wheels of Slots lists each, every level Slots
+//times coarser than the one below, and a timer sits in the finest wheel its
+//delay fits in. adding or cancelling one is O(1) however many are pending, a
+//timer moves down a level at most Levels - 1 times before it fires.
+//resolution is one Tick and a task never fires early
+class TimerWheel
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+	static constexpr std::chrono::milliseconds Tick{1};
+	static constexpr uint32_t SlotBits = 6;
+	static constexpr uint32_t Slots = 1 << SlotBits;
+	static constexpr uint32_t Levels = 4;
+
+	explicit TimerWheel(std::function<void(Task&&)> fire);
+	TimerWheel(const TimerWheel& other) = delete;
+	TimerWheel& operator= (const TimerWheel& other) = delete;
+	//tasks still pending are destroyed without running
+	~TimerWheel();
+
+	void schedule(Clock::time_point when, Task&& job);
+	//stopping token takes the timer out of the wheel and fires it straight
+	//away, the task is expected to check the token itself
+	void schedule(Clock::time_point when, Task&& job, std::stop_token token);
+
+	uint64_t pending() const;
+private:
+	struct Node;
+	struct Cancel
+	{
+		TimerWheel* wheel;
+		Node* node;
+		void operator()() const noexcept { wheel->cancel(node); }
+	};
+	struct Node
+	{
+		Node(Task&& job, uint64_t due) : job(std::move(job)), due(due) {}
+		
+		Task job;
+		uint64_t due; //in ticks since m_start
+		Node* prev = nullptr;
+		Node* next = nullptr;
+		Node** slot = nullptr; //the list it is on, null when it isn't on one
+		bool cancelled = false;
+		std::unique_ptr<std::stop_callback<Cancel>> onCancel;
+	};
+
+	void insert(Node* node);
+	void link(Node* node);
+	void unlink(Node* node);
+	void cancel(Node* node);
+	//moves everything due by now onto m_due, expects m_mutex to be held
+	void advance(uint64_t now);
+	//the next tick worth waking up for, expects m_mutex to be held
+	uint64_t nextWake() const;
+	//the last tick that has fully passed
+	uint64_t currentTick() const;
+	uint64_t tickOf(Clock::time_point when) const;
+	void run(std::stop_token stoken);
+	void fireAll(std::vector<Node*>& nodes);
+
+	std::function<void(Task&&)> m_fire;
+	Clock::time_point m_start;
+	mutable std::mutex m_mutex;
+	std::condition_variable_any m_cv;
+	Node* m_slots[Levels][Slots] = {};
+	uint64_t m_current = 0; //the last tick handled
+	uint64_t m_wakeTick = UINT64_MAX; //when the thread plans to look next
+	std::vector<Node*> m_due; //ready to fire, cancelled ones included
+	std::atomic<uint64_t> m_pending = 0;
+	std::jthread m_thread; //last, so it starts after everything above exists
+};
+
+}
@@ -0,0 +1,123 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+namespace avenir
+{
+
+//bounded Chase-Lev deque. the owning thread pushes and pops at the bottom,
+//any other thread may steal from the top. each cell carries a sequence number
+//so a slot is only written again once whoever claimed its previous value has
+//finished moving it out, this lets us store move-only types by value
+template <typename T>
+class WorkStealingDeque
+{
+public:
+	//capacity must be a power of two
+	explicit WorkStealingDeque(uint32_t capacity = 1024)
+		: m_mask(capacity - 1), m_cells(new Cell[capacity])
+	{
+		for(uint32_t i = 0; i < capacity; i++)
+		{
+			m_cells[i].seq.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	WorkStealingDeque(const WorkStealingDeque& other) = delete;
+	WorkStealingDeque& operator= (const WorkStealingDeque& other) = delete;
+
+	//owner only, returns false and leaves val alone if the deque is full
+	bool push(T&& val)
+	{
+		int64_t b = m_bottom.load(std::memory_order_relaxed);
+		Cell& cell = m_cells[b & m_mask];
+		if(cell.seq.load(std::memory_order_acquire) != b) { return false; }
+
+		cell.value.emplace(std::move(val));
+		cell.seq.store(b + 1, std::memory_order_release);
+		m_bottom.store(b + 1, std::memory_order_release);
+		return true;
+	}
+
+	//owner only
+	std::optional<T> pop()
+	{
+		int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+		m_bottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t t = m_top.load(std::memory_order_relaxed);
+
+		if(t > b) //empty
+		{
+			m_bottom.store(b + 1, std::memory_order_relaxed);
+			return std::nullopt;
+		}
+
+		if(t < b) //no thief can reach this index, and it is reused by the next push
+		{
+			return take(b, b);
+		}
+
+		//last element, race the thieves for it
+		bool won = m_top.compare_exchange_strong(t, t + 1,
+			std::memory_order_seq_cst, std::memory_order_relaxed);
+		m_bottom.store(b + 1, std::memory_order_relaxed);
+		if(!won) { return std::nullopt; }
+		return take(b, b + m_mask + 1);
+	}
+
+	//any thread
+	std::optional<T> steal()
+	{
+		int64_t t = m_top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t b = m_bottom.load(std::memory_order_acquire);
+
+		if(t >= b) { return std::nullopt; }
+
+		if(!m_top.compare_exchange_strong(t, t + 1,
+			std::memory_order_seq_cst, std::memory_order_relaxed))
+		{
+			return std::nullopt;
+		}
+		return take(t, t + m_mask + 1);
+	}
+
+	//only a snapshot, it may be stale as soon as it returns
+	uint32_t size() const
+	{
+		int64_t b = m_bottom.load(std::memory_order_relaxed);
+		int64_t t = m_top.load(std::memory_order_relaxed);
+		return b > t ? static_cast<uint32_t>(b - t) : 0;
+	}
+
+	bool empty() const { return size() == 0; }
+private:
+	struct Cell
+	{
+		std::atomic<int64_t> seq;
+		std::optional<T> value;
+	};
+
+	//index has already been claimed, wait for the push that filled it to be
+	//visible then hand the slot back for the push at nextSeq
+	T take(int64_t index, int64_t nextSeq)
+	{
+		Cell& cell = m_cells[index & m_mask];
+		while(cell.seq.load(std::memory_order_acquire) != index + 1) {}
+
+		T val = std::move(*cell.value);
+		cell.value.reset();
+		cell.seq.store(nextSeq, std::memory_order_release);
+		return val;
+	}
+
+	alignas(64) std::atomic<int64_t> m_top = 0;
+	alignas(64) std::atomic<int64_t> m_bottom = 0;
+	alignas(64) const int64_t m_mask;
+	std::unique_ptr<Cell[]> m_cells;
+};
+
+}
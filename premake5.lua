@@ -18,3 +18,31 @@ project "avenir"
 	filter "configurations:release"
 		defines {"AVENIR_NDEBUG"}
 		optimize "On"
+
+-- every file in bench/ is its own benchmark executable
+for _, file in ipairs(os.matchfiles("bench/*.cpp")) do
+	project (path.getbasename(file))
+		kind "ConsoleApp"
+		language "C++"
+		cppdialect "C++20"
+		targetdir "bin/%{cfg.buildcfg}"
+
+		includedirs {"include/", "bench/"}
+		files {file, "bench/Bench.h"}
+		links {"avenir"}
+
+		-- libstdc++ runs the std::execution::par baselines on TBB
+		filter "system:linux"
+			links {"pthread", "tbb"}
+
+		filter "configurations:debug"
+			defines {"AVENIR_DEBUG"}
+			symbols "On"
+			optimize "Debug"
+
+		filter "configurations:release"
+			defines {"AVENIR_NDEBUG"}
+			optimize "On"
+
+		filter {}
+end
@@ -1,6 +1,86 @@
 #include "Future.h"
 
+#if defined(__linux__)
+#include <cerrno>
+#include <climits>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <algorithm>
+#include <thread>
+#endif
+
 using namespace avenir;
 
-Future<void>::Future(std::shared_ptr<State>& statePtr)
-	: m_statePtr(statePtr) {}
+Future<void>::Future(detail::FutureStateBase* state)
+	: FutureBase(state) {}
+
+#if defined(__linux__)
+
+static long futex(std::atomic<uint32_t>& word, int op, uint32_t val, const timespec* timeout, uint32_t bits)
+{
+	static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t));
+	return syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), op | FUTEX_PRIVATE_FLAG,
+		val, timeout, nullptr, bits);
+}
+
+void detail::futexWait(std::atomic<uint32_t>& word, uint32_t expected)
+{
+	futex(word, FUTEX_WAIT, expected, nullptr, 0);
+}
+
+bool detail::futexWaitUntil(std::atomic<uint32_t>& word, uint32_t expected,
+	std::chrono::steady_clock::time_point deadline)
+{
+	//steady_clock is CLOCK_MONOTONIC, and FUTEX_WAIT_BITSET takes an absolute time on it
+	auto sinceEpoch = deadline.time_since_epoch();
+	if(sinceEpoch.count() <= 0) { return false; }
+	auto seconds = std::chrono::duration_cast<std::chrono::seconds>(sinceEpoch);
+	timespec timeout;
+	timeout.tv_sec = static_cast<time_t>(seconds.count());
+	timeout.tv_nsec = static_cast<long>(std::chrono::duration_cast<std::chrono::nanoseconds>(sinceEpoch - seconds).count());
+
+	if(futex(word, FUTEX_WAIT_BITSET, expected, &timeout, FUTEX_BITSET_MATCH_ANY) == 0) { return true; }
+	return errno != ETIMEDOUT;
+}
+
+void detail::futexWakeAll(std::atomic<uint32_t>& word)
+{
+	futex(word, FUTEX_WAKE, INT_MAX, nullptr, 0);
+}
+
+#else
+
+void detail::futexWait(std::atomic<uint32_t>& word, uint32_t expected)
+{
+	word.wait(expected, std::memory_order_acquire);
+}
+
+bool detail::futexWaitUntil(std::atomic<uint32_t>& word, uint32_t expected,
+	std::chrono::steady_clock::time_point deadline)
+{
+	for(uint32_t spins = 0; spins < 64; spins++)
+	{
+		if(word.load(std::memory_order_acquire) != expected) { return true; }
+		std::this_thread::yield();
+	}
+
+	auto backoff = std::chrono::microseconds(1);
+	while(word.load(std::memory_order_acquire) == expected)
+	{
+		auto now = std::chrono::steady_clock::now();
+		if(now >= deadline) { return false; }
+		std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(backoff, deadline - now));
+		backoff = std::min<std::chrono::microseconds>(backoff * 2, std::chrono::milliseconds(1));
+	}
+	return true;
+}
+
+void detail::futexWakeAll(std::atomic<uint32_t>& word)
+{
+	word.notify_all();
+}
+
+#endif
@@ -0,0 +1,19 @@
+#include "Parallel.h"
+
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+using namespace avenir;
+
+size_t detail::l2CacheSize()
+{
+	static const size_t size = []{
+		long bytes = -1;
+#if defined(_SC_LEVEL2_CACHE_SIZE)
+		bytes = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+		return bytes > 0 ? static_cast<size_t>(bytes) : size_t(256 * 1024);
+	}();
+	return size;
+}
@@ -0,0 +1,125 @@
+#include "Placement.h"
+
+#include <algorithm>
+#include <thread>
+
+#if defined(__linux__)
+#include <filesystem>
+#include <fstream>
+#include <sched.h>
+#include <string>
+#endif
+
+using namespace avenir;
+
+#if defined(__linux__)
+//parses a sysfs cpu list like "0-3,8,10-11"
+static std::vector<uint32_t> parseCpuList(const std::string& text)
+{
+	std::vector<uint32_t> cpus;
+	size_t pos = 0;
+	while(pos < text.size())
+	{
+		size_t end = text.find(',', pos);
+		if(end == std::string::npos) { end = text.size(); }
+		std::string range = text.substr(pos, end - pos);
+		size_t dash = range.find('-');
+		try
+		{
+			uint32_t first = std::stoul(range.substr(0, dash));
+			uint32_t last = dash == std::string::npos ? first : std::stoul(range.substr(dash + 1));
+			for(uint32_t cpu = first; cpu <= last; cpu++) { cpus.push_back(cpu); }
+		}
+		catch(...) {} //a trailing newline or anything else that isn't a number
+		pos = end + 1;
+	}
+	return cpus;
+}
+
+static Topology readTopology()
+{
+	//node directories can have gaps in their numbering, so sort by number
+	std::vector<std::pair<uint32_t, std::vector<uint32_t>>> found;
+	std::error_code error;
+	for(const auto& entry : std::filesystem::directory_iterator("/sys/devices/system/node", error))
+	{
+		std::string name = entry.path().filename().string();
+		if(name.size() <= 4 || name.compare(0, 4, "node") != 0
+			|| !std::all_of(name.begin() + 4, name.end(), [](char c){ return c >= '0' && c <= '9'; }))
+		{
+			continue;
+		}
+		std::ifstream file(entry.path() / "cpulist");
+		std::string text;
+		std::getline(file, text);
+		std::vector<uint32_t> cpus = parseCpuList(text);
+		if(!cpus.empty()) { found.emplace_back(std::stoul(name.substr(4)), std::move(cpus)); }
+	}
+	std::sort(found.begin(), found.end());
+
+	Topology topology;
+	for(auto& node : found) { topology.nodes.push_back(std::move(node.second)); }
+	return topology;
+}
+
+bool avenir::pinThisThread(const std::vector<uint32_t>& cpus)
+{
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for(uint32_t cpu : cpus)
+	{
+		if(cpu < CPU_SETSIZE) { CPU_SET(cpu, &set); }
+	}
+	return CPU_COUNT(&set) != 0 && sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+#else
+static Topology readTopology() { return Topology(); }
+
+bool avenir::pinThisThread(const std::vector<uint32_t>&) { return false; }
+#endif
+
+const Topology& Topology::get()
+{
+	static const Topology topology = []{
+		Topology t = readTopology();
+		if(t.nodes.empty())
+		{
+			uint32_t count = std::max(1u, std::thread::hardware_concurrency());
+			t.nodes.emplace_back();
+			for(uint32_t cpu = 0; cpu < count; cpu++) { t.nodes.back().push_back(cpu); }
+		}
+		return t;
+	}();
+	return topology;
+}
+
+uint32_t Topology::nodeOf(uint32_t cpu) const
+{
+	for(uint32_t node = 0; node < nodes.size(); node++)
+	{
+		if(std::find(nodes[node].begin(), nodes[node].end(), cpu) != nodes[node].end()) { return node; }
+	}
+	return 0;
+}
+
+Placement Placement::perCore()
+{
+	const Topology& topology = Topology::get();
+	Placement placement;
+	for(uint32_t node = 0; node < topology.nodes.size(); node++)
+	{
+		for(uint32_t cpu : topology.nodes[node]) { placement.sets.push_back({{cpu}, node}); }
+	}
+	return placement;
+}
+
+Placement Placement::perNode()
+{
+	const Topology& topology = Topology::get();
+	Placement placement;
+	for(uint32_t node = 0; node < topology.nodes.size(); node++)
+	{
+		placement.sets.push_back({topology.nodes[node], node});
+	}
+	return placement;
+}
@@ -0,0 +1,13 @@
+#include "SpinWait.h"
+
+using namespace avenir;
+
+//on a single core spinning only delays the thread we are waiting for
+std::atomic<uint32_t> AdaptiveSpinner::s_maxRounds =
+	std::thread::hardware_concurrency() > 1 ? AdaptiveSpinner::PauseRounds + 54 : 0;
+
+AdaptiveSpinner& AdaptiveSpinner::forThisThread()
+{
+	static thread_local AdaptiveSpinner spinner;
+	return spinner;
+}
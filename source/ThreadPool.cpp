@@ -1,10 +1,46 @@
 #include "ThreadPool.h"
 
+#include <algorithm>
+
 using namespace avenir;
 
+thread_local ThreadPool::Worker* ThreadPool::s_currentWorker = nullptr;
+
+//cheap per thread rng for picking steal victims
+static uint32_t nextRandom()
+{
+	thread_local uint32_t state = static_cast<uint32_t>(
+		std::hash<std::thread::id>{}(std::this_thread::get_id())) | 1;
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+//tries every victim's deque once, starting at a random one
+template <typename List, typename Worker>
+static std::optional<Task> stealFrom(const List& victims, const Worker* thief)
+{
+	std::optional<Task> job;
+	uint32_t count = victims.size();
+	uint32_t start = count != 0 ? nextRandom() % count : 0;
+	for(uint32_t i = 0; i < count && !job; i++)
+	{
+		const auto& victim = victims[(start + i) % count];
+		if(&*victim != thief) { job = victim->deque.steal(); }
+	}
+	return job;
+}
+
+ThreadPool::ThreadPool(uint32_t numThreads, std::list<Task>& queue)
+{
+	pushTasks(queue);
+	addThreads(numThreads);
+}
+
 ThreadPool::ThreadPool(uint32_t numThreads, std::list<std::packaged_task<void()>>& queue)
 {
-	m_jobQueue.splice(m_jobQueue.end(), queue);
+	pushTasks(queue);
 	addThreads(numThreads);
 }
 	
@@ -13,63 +49,229 @@ ThreadPool::ThreadPool(uint32_t numThreads)
 	addThreads(numThreads);
 }
 
+ThreadPool::ThreadPool(uint32_t numThreads, Placement placement)
+	: m_placement(std::move(placement))
+{
+	addThreads(numThreads);
+}
+
 ThreadPool::~ThreadPool()
 {
+	//stop the timer thread first, it pushes into us
+	m_timers.reset();
+	//nothing may grow back while we tear down
+	m_maxThreads.store(0);
 	removeThreads(getThreadCount());
+	reapRetired(true);
 }
 
 void ThreadPool::addThreads(uint32_t numThreads)
 {
+	reapRetired();
+	std::lock_guard<std::mutex> lock(m_poolMutex);
+	startWorkers(numThreads);
+}
+
+void ThreadPool::startWorkers(uint32_t numThreads)
+{
+	std::vector<Worker*> added;
 	for(uint32_t i = 0; i < numThreads; i++)
 	{
-		m_pool.emplace([this](std::stop_token stoken){
-			while (true) {
-				std::unique_lock<std::mutex> lock(m_queueMutex);
-				m_cv.wait(lock, stoken, [this] {return !m_jobQueue.empty();});
-				if(stoken.stop_requested()) { return; }
-				
-				auto job = std::move(m_jobQueue.front());
-				m_jobQueue.pop_front();
-				
-				lock.unlock();
-				
-				job();
-				
-				if(m_jobQueue.empty())
-				{
-					m_waitFlag.clear();
-					m_waitFlag.notify_all();
-				}
-				
-				if(stoken.stop_requested()) { return; }
-			}
+		m_pool.emplace_back(std::make_shared<Worker>());
+		m_pool.back()->owner = this;
+		if(!m_placement.sets.empty())
+		{
+			m_pool.back()->placement = m_placement.sets[(m_pool.size() - 1) % m_placement.sets.size()];
+		}
+		added.push_back(m_pool.back().get());
+	}
+	
+	//publish before starting so every deque a job can land in is visible to thieves
+	publishWorkers();
+	
+	for(Worker* worker : added)
+	{
+		worker->thread = std::jthread([this, worker](std::stop_token stoken){
+			if(!worker->placement.cpus.empty()) { pinThisThread(worker->placement.cpus); }
+			workerLoop(*worker, stoken);
+			worker->finished.store(true);
 		});
 	}
 }
 
+void ThreadPool::publishWorkers()
+{
+	//a retiring worker may still be running a job that pushes children onto
+	//its deque, they have to stay stealable until it hands them back
+	auto published = std::make_shared<WorkerList>(m_pool);
+	for(auto& worker : m_retired)
+	{
+		if(!worker->drained) { published->push_back(worker); }
+	}
+	
+	std::lock_guard<std::mutex> workersLock(m_workersMutex);
+	m_workers = std::move(published);
+	m_threadCount.store(m_pool.size());
+	m_poolVersion++;
+}
+
+void ThreadPool::setPlacement(Placement placement)
+{
+	std::lock_guard<std::mutex> lock(m_poolMutex);
+	m_placement = std::move(placement);
+}
+
 void ThreadPool::removeThreads(uint32_t numThreads)
 {
-	uint32_t limit = numThreads > getThreadCount() ? getThreadCount() : numThreads;
-	for(uint32_t i = 0; i < limit; i++)
+	retireThreads(numThreads).wait();
+	reapRetired(true);
+}
+
+Future<void> ThreadPool::retireThreads(uint32_t numThreads)
+{
+	std::unique_lock<std::mutex> lock(m_poolMutex);
+	uint32_t limit = numThreads > m_pool.size() ? m_pool.size() : numThreads;
+	if(limit == 0) { return makeReadyFuture(); }
+	
+	auto retirement = std::make_shared<Retirement>();
+	retirement->remaining.store(limit);
+	Future<void> done = retirement->done.getFuture();
+	
+	WorkerList removed(m_pool.end() - limit, m_pool.end());
+	m_pool.erase(m_pool.end() - limit, m_pool.end());
+	for(auto& worker : removed)
 	{
-		m_pool.top().request_stop();
-		m_cv.notify_all();
-		m_pool.pop();
+		worker->retirement = retirement;
+		m_retired.push_back(worker);
 	}
+	publishWorkers();
+	lock.unlock();
+	
+	//the stop callback wakes a parked worker, nobody else is disturbed
+	for(auto& worker : removed) { worker->thread.request_stop(); }
+	return done;
+}
+
+void ThreadPool::setElastic(uint32_t minThreads, uint32_t maxThreads, std::chrono::milliseconds keepAlive, uint32_t growDepth)
+{
+	m_minThreads.store(minThreads);
+	m_keepAlive.store(keepAlive);
+	m_growDepth.store(growDepth);
+	m_maxThreads.store(maxThreads);
+	{
+		//parked workers start over with the new keepAlive
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		while(!m_sleepers.empty()) { unpark(m_sleepers.size() - 1); }
+	}
+	
+	reapRetired();
+	std::lock_guard<std::mutex> lock(m_poolMutex);
+	if(maxThreads != 0 && m_pool.size() < minThreads) { startWorkers(minThreads - m_pool.size()); }
+}
+
+void ThreadPool::grow()
+{
+	uint32_t maxThreads = m_maxThreads.load(std::memory_order_relaxed);
+	uint32_t threads = m_threadCount.load();
+	if(threads >= maxThreads) { return; }
+	if(threads != 0 && m_jobCount.load() <= m_growDepth.load(std::memory_order_relaxed)) { return; }
+	
+	reapRetired();
+	//checked again under the lock, a thread retiring holds it while it
+	//makes sure no job is left behind
+	std::lock_guard<std::mutex> lock(m_poolMutex);
+	threads = m_pool.size();
+	if(threads >= m_maxThreads.load() || (threads != 0 && m_jobCount.load() <= m_growDepth.load())) { return; }
+	startWorkers(1);
+}
+
+bool ThreadPool::retire(Worker& worker)
+{
+	std::lock_guard<std::mutex> lock(m_poolMutex);
+	//a job pushed after we stopped counting as idle would otherwise wait for
+	//a busy thread, or for nobody at all if we are the last one
+	if(m_maxThreads.load() == 0 || m_pool.size() <= m_minThreads.load() || m_jobCount.load() != 0) { return false; }
+	
+	auto it = std::find_if(m_pool.begin(), m_pool.end(), [&](const auto& w){ return w.get() == &worker; });
+	if(it == m_pool.end()) { return false; }
+	m_retired.push_back(std::move(*it));
+	m_pool.erase(it);
+	publishWorkers();
+	return true;
+}
+
+void ThreadPool::reapRetired(bool all)
+{
+	WorkerList done;
+	{
+		std::lock_guard<std::mutex> lock(m_poolMutex);
+		auto running = std::partition(m_retired.begin(), m_retired.end(),
+			[all](const auto& w){ return !all && !w->finished.load(); });
+		done.assign(std::make_move_iterator(running), std::make_move_iterator(m_retired.end()));
+		m_retired.erase(running, m_retired.end());
+	}
+	for(auto& worker : done) { worker->thread.join(); }
 }
 
 std::list<std::packaged_task<void()>> ThreadPool::moveTasks()
 {
-	std::unique_lock<std::mutex> lock(m_queueMutex);
-	std::list<std::packaged_task<void()>> queueTmp;
-	queueTmp.splice(queueTmp.end(), m_jobQueue);
+	std::list<std::packaged_task<void()>> converted;
+	for(Task& task : moveTaskList()) { converted.emplace_back(std::move(task)); }
+	return converted;
+}
+
+std::list<Task> ThreadPool::moveTaskList()
+{
+	std::list<Task> queueTmp;
+	for(Level& level : m_levels)
+	{
+		//the ring holds the older jobs, the lock keeps a refill from moving
+		//spilled ones into it halfway through
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		while(std::optional<Task> job = level.inject.tryPop())
+		{
+			queueTmp.emplace_back(std::move(*job));
+			m_jobCount--;
+		}
+		
+		uint32_t count = level.overflow.size();
+		queueTmp.splice(queueTmp.end(), level.overflow);
+		level.overflowCount -= count;
+		m_jobCount -= count;
+	}
+	
+	for(auto& worker : *workers())
+	{
+		while(std::optional<Task> job = worker->deque.steal())
+		{
+			queueTmp.emplace_back(std::move(*job));
+			m_jobCount--;
+		}
+	}
+	wakeProducers();
 	return queueTmp;
 }
 
-void ThreadPool::pushTasks(std::list<std::packaged_task<void()>>& tasks)
+void ThreadPool::pushTasks(std::list<Task>& tasks)
 {
 	std::unique_lock<std::mutex> lock(m_queueMutex);
-	m_jobQueue.splice(m_jobQueue.end(), tasks);
+	uint32_t count = tasks.size();
+	Level& level = m_levels[static_cast<uint32_t>(Priority::Normal)];
+	m_jobCount += count;
+	level.overflowCount += count;
+	level.overflow.splice(level.overflow.end(), tasks);
+	lock.unlock();
+	
+	wake(count);
+}
+
+void ThreadPool::pushTasks(std::list<std::packaged_task<void()>>& tasks)
+{
+	//the list nodes can't be reused, so each task gets wrapped into a new one
+	std::list<Task> converted;
+	for(auto& task : tasks) { converted.emplace_back(std::move(task)); }
+	tasks.clear();
+	pushTasks(converted);
 }
 
 void ThreadPool::waitTilEmpty()
@@ -78,6 +280,455 @@ void ThreadPool::waitTilEmpty()
 	m_waitFlag.wait(true);
 }
 
-uint32_t ThreadPool::getThreadCount() const { return m_pool.size(); }
+uint32_t ThreadPool::getThreadCount() const { return m_threadCount.load(); }
+
+uint32_t ThreadPool::jobsRemaining() const { return m_jobCount.load(); }
+
+void ThreadPool::setCapacity(uint32_t capacity, OverflowPolicy policy)
+{
+	m_overflowPolicy.store(policy);
+	m_capacity.store(capacity);
+	//blocked producers check again, there may be room now
+	wakeProducers();
+}
+
+uint32_t ThreadPool::getCapacity() const { return m_capacity.load(); }
+
+OverflowPolicy ThreadPool::getOverflowPolicy() const { return m_overflowPolicy.load(); }
+
+uint32_t ThreadPool::getHighWaterMark() const { return m_highWaterMark.load(); }
+
+void ThreadPool::resetHighWaterMark() { m_highWaterMark.store(m_jobCount.load()); }
+
+void ThreadPool::enqueue(Task&& job, Priority priority)
+{
+	//count first so a worker deciding whether to sleep can't miss this job
+	if(!tryReserve(1) && !makeRoom(job)) { return; }
+	
+	place(std::move(job), priority);
+}
+
+TimerWheel& ThreadPool::timers()
+{
+	std::call_once(m_timersOnce, [this]{
+		m_timers = std::make_unique<TimerWheel>([this](Task&& job){ postUncapped(std::move(job)); });
+	});
+	return *m_timers;
+}
+
+void ThreadPool::postUncapped(Task&& job)
+{
+	//never blocks, never runs the job here and never fails
+	m_jobCount++;
+	place(std::move(job), Priority::Normal);
+}
 
-uint32_t ThreadPool::jobsRemaining() const { return m_jobQueue.size(); }
+void ThreadPool::place(Task&& job, Priority priority)
+{
+	//the local deques only hold Normal jobs, anything else has to be where
+	//every thread checks its level first
+	Worker* worker = s_currentWorker;
+	if(priority != Priority::Normal || worker == nullptr || worker->owner != this || !worker->deque.push(std::move(job)))
+	{
+		//not one of our threads, or its deque is full
+		pushShared(std::move(job), priority);
+	}
+	
+	wake(1);
+}
+
+bool ThreadPool::tryReserve(uint32_t count)
+{
+	uint32_t capacity = m_capacity.load(std::memory_order_relaxed);
+	uint32_t queued;
+	if(capacity == 0)
+	{
+		queued = m_jobCount.fetch_add(count) + count;
+	}
+	else
+	{
+		uint32_t current = m_jobCount.load();
+		do
+		{
+			if(current + count > capacity) { return false; }
+		} while(!m_jobCount.compare_exchange_weak(current, current + count));
+		queued = current + count;
+	}
+	
+	uint32_t mark = m_highWaterMark.load(std::memory_order_relaxed);
+	while(queued > mark && !m_highWaterMark.compare_exchange_weak(mark, queued, std::memory_order_relaxed)) {}
+	return true;
+}
+
+bool ThreadPool::makeRoom(Task& job)
+{
+	Worker* worker = s_currentWorker;
+	bool ownThread = worker != nullptr && worker->owner == this;
+	
+	switch(m_overflowPolicy.load(std::memory_order_relaxed))
+	{
+	case OverflowPolicy::Fail:
+		throw QueueFullError();
+	case OverflowPolicy::Block:
+		if(!ownThread)
+		{
+			waitForRoom();
+			return true;
+		}
+		[[fallthrough]];
+	case OverflowPolicy::RunInline:
+		runJob(job);
+		return false;
+	case OverflowPolicy::DropOldest:
+		while(!tryReserve(1))
+		{
+			//nothing to drop means the slots are held by pushes still in flight
+			if(!takeOldest()) { std::this_thread::yield(); }
+		}
+		return true;
+	}
+	return true;
+}
+
+void ThreadPool::waitForRoom()
+{
+	//counted as blocked before looking, so a thread freeing a slot either
+	//sees us or we see the slot
+	m_blockedProducers++;
+	while(true)
+	{
+		uint32_t signal = m_roomSignal.load();
+		if(tryReserve(1)) { break; }
+		m_roomSignal.wait(signal);
+	}
+	m_blockedProducers--;
+}
+
+std::optional<Task> ThreadPool::takeOldest()
+{
+	std::optional<Task> job;
+	for(uint32_t level = PriorityLevels; level-- > 0 && !job;)
+	{
+		job = popLevel(level, nullptr);
+	}
+	
+	//the far end of a deque is its oldest job
+	if(!job)
+	{
+		for(auto& worker : *workers())
+		{
+			if((job = worker->deque.steal())) { break; }
+		}
+	}
+	
+	if(job) { jobTaken(); }
+	return job;
+}
+
+void ThreadPool::jobTaken()
+{
+	m_jobCount--;
+	wakeProducers();
+}
+
+void ThreadPool::wakeProducers()
+{
+	if(m_blockedProducers.load() == 0) { return; }
+	m_roomSignal++;
+	m_roomSignal.notify_all();
+}
+
+void ThreadPool::pushShared(Task&& job, Priority priority)
+{
+	Level& level = m_levels[static_cast<uint32_t>(priority)];
+	//while anything is spilled, new jobs queue up behind it
+	if(level.overflowCount.load() == 0 && level.inject.tryPush(std::move(job))) { return; }
+	
+	std::lock_guard<std::mutex> lock(m_queueMutex);
+	level.overflow.emplace_back(std::move(job));
+	level.overflowCount++;
+}
+
+void ThreadPool::enqueueBulk(std::vector<Task>& jobs)
+{
+	uint32_t count = jobs.size();
+	if(!tryReserve(count))
+	{
+		if(m_overflowPolicy.load(std::memory_order_relaxed) == OverflowPolicy::Fail) { throw QueueFullError(); }
+		
+		//over capacity, the rest of the policies work one job at a time
+		for(Task& job : jobs) { enqueue(std::move(job)); }
+		jobs.clear();
+		return;
+	}
+	
+	Level& level = m_levels[static_cast<uint32_t>(Priority::Normal)];
+	if(level.overflowCount.load() != 0 || !level.inject.tryPushBulk(jobs.data(), count))
+	{
+		std::unique_lock<std::mutex> lock(m_queueMutex);
+		for(Task& job : jobs) { level.overflow.emplace_back(std::move(job)); }
+		level.overflowCount += count;
+	}
+	jobs.clear();
+	
+	wake(count);
+}
+
+bool ThreadPool::runPendingJob()
+{
+	Worker* worker = s_currentWorker;
+	std::optional<Task> job = findJob(worker != nullptr && worker->owner == this ? worker : nullptr);
+	if(!job) { return false; }
+	
+	runJob(*job);
+	return true;
+}
+
+std::optional<Task> ThreadPool::findJob(Worker* worker)
+{
+	std::optional<Task> job;
+	
+	//a level that has waited long enough goes ahead of the ones above it
+	for(uint32_t level = 1; level < PriorityLevels && !job; level++)
+	{
+		if(m_levels[level].passedOver.load(std::memory_order_relaxed) >= AgingLimit)
+		{
+			m_levels[level].passedOver.store(0, std::memory_order_relaxed);
+			job = popLevel(level, worker);
+		}
+	}
+	
+	for(uint32_t level = 0; level < PriorityLevels && !job; level++)
+	{
+		job = popLevel(level, worker);
+		if(job) { passOver(level, worker); }
+	}
+	
+	if(!job)
+	{
+		if(worker != nullptr)
+		{
+			//workers keep their own copy of the list
+			uint32_t version = m_poolVersion.load();
+			if(worker->victimsVersion != version)
+			{
+				refreshVictims(*worker);
+				worker->victimsVersion = version;
+			}
+			//deques on our own node are in nearby caches and local memory
+			job = stealFrom(worker->nearVictims, worker);
+			if(!job) { job = stealFrom(worker->farVictims, worker); }
+		}
+		else
+		{
+			//anyone else has to fetch it
+			job = stealFrom(*workers(), worker);
+		}
+	}
+	
+	if(job) { jobTaken(); }
+	return job;
+}
+
+std::optional<Task> ThreadPool::popLevel(uint32_t level, Worker* worker)
+{
+	std::optional<Task> job;
+	Level& shared = m_levels[level];
+	
+	if(worker != nullptr && level == static_cast<uint32_t>(Priority::Normal))
+	{
+		job = worker->deque.pop();
+	}
+	
+	if(!job)
+	{
+		job = shared.inject.tryPop();
+	}
+	
+	if(!job && shared.overflowCount.load() != 0)
+	{
+		std::unique_lock<std::mutex> lock(m_queueMutex);
+		if(!shared.overflow.empty())
+		{
+			job.emplace(std::move(shared.overflow.front()));
+			shared.overflow.pop_front();
+			//the ring has drained, so everything in it is older than the spill.
+			//refilling it in order lets pushes go back to the ring once the
+			//spill is gone
+			uint32_t moved = 1;
+			while(!shared.overflow.empty() && shared.inject.tryPush(std::move(shared.overflow.front())))
+			{
+				shared.overflow.pop_front();
+				moved++;
+			}
+			shared.overflowCount -= moved;
+		}
+	}
+	return job;
+}
+
+void ThreadPool::passOver(uint32_t level, Worker* worker)
+{
+	//other workers' deques aren't looked at, they count for themselves
+	for(uint32_t lower = level + 1; lower < PriorityLevels; lower++)
+	{
+		Level& waiting = m_levels[lower];
+		bool local = worker != nullptr && lower == static_cast<uint32_t>(Priority::Normal) && !worker->deque.empty();
+		if(local || waiting.inject.size() != 0 || waiting.overflowCount.load(std::memory_order_relaxed) != 0)
+		{
+			waiting.passedOver.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+}
+
+void ThreadPool::workerLoop(Worker& worker, std::stop_token stoken)
+{
+	s_currentWorker = &worker;
+	std::stop_callback wakeOnStop(stoken, [this, &worker]{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		wakeSleeper(worker);
+	});
+	
+	while(!stoken.stop_requested())
+	{
+		std::optional<Task> job = findJob(&worker);
+		if(!job)
+		{
+			//a spinning worker doesn't count as idle, producers skip the wake up for it
+			if(worker.spinner.spin([&]{ return m_jobCount.load() != 0 || stoken.stop_requested(); }))
+			{
+				continue;
+			}
+			
+			//elastic, a thread nobody needed for keepAlive leaves
+			if(!park(worker, stoken) && !stoken.stop_requested() && retire(worker)) { break; }
+			continue;
+		}
+		
+		//a burst pushed while we were still counted as idle didn't grow the
+		//pool, so look again now that nobody is idle
+		if(m_maxThreads.load(std::memory_order_relaxed) != 0 && m_idleCount.load() == 0) { grow(); }
+		
+		runJob(*job);
+	}
+	
+	//hand back anything still on our deque so the remaining threads can run it
+	uint32_t handedBack = 0;
+	while(std::optional<Task> job = worker.deque.pop())
+	{
+		pushShared(std::move(*job));
+		handedBack++;
+	}
+	wake(handedBack);
+	{
+		//nothing is left to steal from us
+		std::lock_guard<std::mutex> lock(m_poolMutex);
+		worker.drained = true;
+		publishWorkers();
+	}
+	
+	//the list holds a reference back to us
+	worker.victims.reset();
+	worker.nearVictims.clear();
+	worker.farVictims.clear();
+	s_currentWorker = nullptr;
+	
+	if(worker.retirement && --worker.retirement->remaining == 0) { worker.retirement->done.setValue(); }
+}
+
+bool ThreadPool::park(Worker& worker, const std::stop_token& stoken)
+{
+	std::unique_lock<std::mutex> lock(m_queueMutex);
+	worker.wakeSlot.store(0, std::memory_order_relaxed);
+	m_sleepers.push_back(&worker);
+	m_idleCount++;
+	//a producer that found nobody idle pushed before we counted ourselves,
+	//and a stop request from before we were on the list couldn't find us
+	if(m_jobCount.load() != 0 || stoken.stop_requested())
+	{
+		unpark(m_sleepers.size() - 1);
+		return true;
+	}
+	bool elastic = m_maxThreads.load(std::memory_order_relaxed) != 0;
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + m_keepAlive.load();
+	lock.unlock();
+	
+	while(worker.wakeSlot.load() == 0)
+	{
+		if(!elastic) { detail::futexWait(worker.wakeSlot, 0); }
+		else if(!detail::futexWaitUntil(worker.wakeSlot, 0, deadline)) { break; }
+	}
+	if(worker.wakeSlot.load() != 0) { return true; }
+	
+	//timed out, unless we were woken just now
+	lock.lock();
+	if(worker.wakeSlot.load() != 0) { return true; }
+	m_sleepers.erase(std::find(m_sleepers.begin(), m_sleepers.end(), &worker));
+	m_idleCount--;
+	return false;
+}
+
+void ThreadPool::unpark(size_t sleeper)
+{
+	Worker* worker = m_sleepers[sleeper];
+	m_sleepers[sleeper] = m_sleepers.back();
+	m_sleepers.pop_back();
+	m_idleCount--;
+	worker->wakeSlot.store(1);
+	detail::futexWakeAll(worker->wakeSlot);
+}
+
+void ThreadPool::wakeSleeper(Worker& worker)
+{
+	auto it = std::find(m_sleepers.begin(), m_sleepers.end(), &worker);
+	if(it != m_sleepers.end()) { unpark(it - m_sleepers.begin()); }
+}
+
+void ThreadPool::refreshVictims(Worker& worker)
+{
+	worker.victims = workers();
+	worker.nearVictims.clear();
+	worker.farVictims.clear();
+	for(const auto& victim : *worker.victims)
+	{
+		if(victim.get() == &worker) { continue; }
+		(victim->placement.node == worker.placement.node ? worker.nearVictims : worker.farVictims).push_back(victim.get());
+	}
+}
+
+void ThreadPool::runJob(Task& job)
+{
+	try { job(); }
+	catch(...) {} //only posted jobs can throw, pushJob's jobs catch
+	
+	if(m_jobCount.load() == 0)
+	{
+		m_waitFlag.clear();
+		m_waitFlag.notify_all();
+	}
+}
+
+void ThreadPool::wake(uint32_t count)
+{
+	//producers only touch m_queueMutex when someone is asleep
+	uint32_t idle = m_idleCount.load();
+	if(count == 0) { return; }
+	if(idle == 0)
+	{
+		if(m_maxThreads.load(std::memory_order_relaxed) != 0) { grow(); }
+		return;
+	}
+	
+	//the most recently parked go first, their caches are the warmest
+	std::lock_guard<std::mutex> lock(m_queueMutex);
+	for(uint32_t i = 0; i < count && !m_sleepers.empty(); i++)
+	{
+		unpark(m_sleepers.size() - 1);
+	}
+}
+
+std::shared_ptr<const ThreadPool::WorkerList> ThreadPool::workers() const
+{
+	std::lock_guard<std::mutex> lock(m_workersMutex);
+	return m_workers;
+}
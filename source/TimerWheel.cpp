@@ -0,0 +1,233 @@
+#include "TimerWheel.h"
+
+#include <algorithm>
+
+using namespace avenir;
+
+TimerWheel::TimerWheel(std::function<void(Task&&)> fire)
+	: m_fire(std::move(fire)), m_start(Clock::now()),
+	m_thread([this](std::stop_token stoken){ run(stoken); })
+{
+}
+
+TimerWheel::~TimerWheel()
+{
+	m_thread.request_stop();
+	m_thread.join();
+
+	//unlinked under the lock so a racing cancel sees them gone, freed outside
+	//it because dropping a stop_callback waits for one that is running
+	std::vector<Node*> nodes;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for(auto& level : m_slots)
+		{
+			for(Node*& head : level)
+			{
+				while(head != nullptr)
+				{
+					Node* node = head;
+					unlink(node);
+					nodes.push_back(node);
+				}
+			}
+		}
+		nodes.insert(nodes.end(), m_due.begin(), m_due.end());
+		m_due.clear();
+	}
+	for(Node* node : nodes)
+	{
+		node->onCancel.reset();
+		delete node;
+	}
+}
+
+void TimerWheel::schedule(Clock::time_point when, Task&& job)
+{
+	Node* node = new Node(std::move(job), tickOf(when));
+	insert(node);
+}
+
+void TimerWheel::schedule(Clock::time_point when, Task&& job, std::stop_token token)
+{
+	Node* node = new Node(std::move(job), tickOf(when));
+	//registered before the node goes in, a stop that comes first marks it
+	//cancelled and insert fires it right away
+	if(token.stop_possible())
+	{
+		node->onCancel = std::make_unique<std::stop_callback<Cancel>>(std::move(token), Cancel{this, node});
+	}
+	insert(node);
+}
+
+uint64_t TimerWheel::pending() const { return m_pending.load(); }
+
+void TimerWheel::insert(Node* node)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		//the thread doesn't advance an empty wheel, catch up here instead of
+		//leaving it to walk every tick it slept through one at a time
+		if(m_pending.load(std::memory_order_relaxed) == 0) { m_current = std::max(m_current, currentTick()); }
+		if(node->cancelled || node->due <= m_current)
+		{
+			m_due.push_back(node);
+		}
+		else
+		{
+			link(node);
+			m_pending++;
+			if(node->due >= m_wakeTick) { return; }
+			//due before the thread planned to look again
+			m_wakeTick = node->due;
+		}
+	}
+	m_cv.notify_one();
+}
+
+void TimerWheel::link(Node* node)
+{
+	//the finest level whose range covers the delay, anything further out
+	//than the top level reaches waits in its last slot and gets placed again
+	uint64_t delay = node->due - m_current;
+	uint32_t level = 0;
+	while(level + 1 < Levels && delay >= (uint64_t(1) << (SlotBits * (level + 1)))) { level++; }
+	uint64_t due = std::min(node->due, m_current + (uint64_t(1) << (SlotBits * Levels)) - 1);
+	Node*& head = m_slots[level][(due >> (SlotBits * level)) & (Slots - 1)];
+
+	node->prev = nullptr;
+	node->next = head;
+	if(head != nullptr) { head->prev = node; }
+	head = node;
+	node->slot = &head;
+}
+
+void TimerWheel::unlink(Node* node)
+{
+	if(node->prev != nullptr) { node->prev->next = node->next; }
+	else { *node->slot = node->next; }
+	if(node->next != nullptr) { node->next->prev = node->prev; }
+	node->prev = nullptr;
+	node->next = nullptr;
+	node->slot = nullptr;
+}
+
+void TimerWheel::cancel(Node* node)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		node->cancelled = true;
+		//not on a list: not inserted yet, or already on its way out
+		if(node->slot == nullptr) { return; }
+		unlink(node);
+		m_pending--;
+		m_due.push_back(node);
+	}
+	m_cv.notify_one();
+}
+
+void TimerWheel::advance(uint64_t now)
+{
+	if(m_pending.load(std::memory_order_relaxed) == 0)
+	{
+		m_current = std::max(m_current, now);
+		return;
+	}
+
+	while(m_current < now)
+	{
+		uint64_t tick = ++m_current;
+		//at every wrap of a level, the matching slot of the level above is
+		//spread over the levels below it
+		for(uint32_t level = 1; level < Levels; level++)
+		{
+			if((tick & ((uint64_t(1) << (SlotBits * level)) - 1)) != 0) { break; }
+			Node*& head = m_slots[level][(tick >> (SlotBits * level)) & (Slots - 1)];
+			Node* node = head;
+			head = nullptr;
+			while(node != nullptr)
+			{
+				Node* next = node->next;
+				link(node);
+				node = next;
+			}
+		}
+
+		Node*& head = m_slots[0][tick & (Slots - 1)];
+		while(head != nullptr)
+		{
+			Node* node = head;
+			unlink(node);
+			m_pending--;
+			m_due.push_back(node);
+		}
+	}
+}
+
+uint64_t TimerWheel::nextWake() const
+{
+	if(m_pending.load(std::memory_order_relaxed) == 0) { return UINT64_MAX; }
+
+	//something in the rest of this turn of the finest wheel, or else the
+	//next cascade which may bring timers down into it
+	uint64_t wrap = (m_current | (Slots - 1)) + 1;
+	for(uint64_t tick = m_current + 1; tick < wrap; tick++)
+	{
+		if(m_slots[0][tick & (Slots - 1)] != nullptr) { return tick; }
+	}
+	return wrap;
+}
+
+uint64_t TimerWheel::currentTick() const
+{
+	return static_cast<uint64_t>((Clock::now() - m_start) / Tick);
+}
+
+uint64_t TimerWheel::tickOf(Clock::time_point when) const
+{
+	if(when <= m_start) { return 0; }
+	//rounded up so nothing fires early
+	return static_cast<uint64_t>((when - m_start + Tick - Clock::duration(1)) / Tick);
+}
+
+void TimerWheel::run(std::stop_token stoken)
+{
+	std::vector<Node*> due;
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while(!stoken.stop_requested())
+	{
+		advance(currentTick());
+		if(!m_due.empty())
+		{
+			due.swap(m_due);
+			lock.unlock();
+			fireAll(due);
+			lock.lock();
+			continue;
+		}
+
+		m_wakeTick = nextWake();
+		if(m_wakeTick == UINT64_MAX)
+		{
+			m_cv.wait(lock, stoken, [this]{ return !m_due.empty() || m_wakeTick != UINT64_MAX; });
+		}
+		else
+		{
+			uint64_t planned = m_wakeTick;
+			m_cv.wait_until(lock, stoken, m_start + planned * Tick, [this, planned]{ return !m_due.empty() || m_wakeTick != planned; });
+		}
+	}
+	m_wakeTick = UINT64_MAX;
+}
+
+void TimerWheel::fireAll(std::vector<Node*>& nodes)
+{
+	for(Node* node : nodes)
+	{
+		//waits for a cancel callback that is still on its way out
+		node->onCancel.reset();
+		m_fire(std::move(node->job));
+		delete node;
+	}
+	nodes.clear();
+}